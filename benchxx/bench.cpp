@@ -0,0 +1,728 @@
+// see LICENSE.md for license.
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include "benchxx/corpus.hpp"
+#include "benchxx/counters.hpp"
+#include "densityxx/file_buffer.hpp"
+#include "densityxx/block.hpp"
+#include "densityxx/context.hpp"
+#include "densityxx/copy.hpp"
+#include "densityxx/chameleon.hpp"
+#include "densityxx/cheetah.hpp"
+#include "densityxx/lion.hpp"
+#include "densityxx/adaptive.hpp"
+#include "densityxx/api.hpp"
+
+namespace density {
+    // The ways into the kernels, from the innermost out:
+    //   kernel  the *_encode_t/*_decode_t alone, in memory, without blocks nor headers
+    //   api     the one-shot compress()/decompress() of api.hpp
+    //   stream  the block layer fed by file_buffer_t, as sharcxx does with streams
+    typedef enum {
+        bench_path_kernel,
+        bench_path_api,
+        bench_path_stream
+    } bench_path_t;
+    DENSITY_ENUM_RENDER3(bench_path, kernel, api, stream);
+    const uint_fast8_t bench_paths = 3;
+    // The modes by sharcxx -c level, compression_mode_auto only picks one of them.
+    static const compression_mode_t bench_modes[] = {
+        compression_mode_copy, compression_mode_chameleon_algorithm,
+        compression_mode_cheetah_algorithm, compression_mode_lion_algorithm,
+        compression_mode_adaptive
+    };
+    const uint_fast8_t bench_levels = sizeof(bench_modes) / sizeof(bench_modes[0]);
+
+    typedef std::chrono::steady_clock bench_clock_t;
+    static DENSITY_INLINE double bench_elapsed(const bench_clock_t::time_point start)
+    {   return std::chrono::duration<double>(bench_clock_t::now() - start).count(); }
+
+    // Best of the repetitions, a run disturbed by the rest of the system only gets slower.
+    // The events are those of the best repetitions, negative when not counted.
+    struct bench_result_t {
+        bench_path_t path;
+        compression_mode_t mode;
+        corpus_t corpus;
+        uint_fast64_t size, compressed;
+        double compress_seconds, decompress_seconds;
+        double compress_events[counter_kinds], decompress_events[counter_kinds];
+        bool verified;
+    };
+
+    // Every path compresses data into its own storage and decompresses it back, in seconds,
+    // negative on failure. The counters only run over the calls into the kernels or the
+    // block layer, not over the I/O around them.
+    class bench_path_base_t {
+    public:
+        const std::vector<uint8_t> &data;
+        const compression_mode_t mode;
+        counters_t &counters;
+        uint_fast64_t compressed_size;
+
+        bench_path_base_t(const std::vector<uint8_t> &data, const compression_mode_t mode,
+                          counters_t &counters):
+            data(data), mode(mode), counters(counters), compressed_size(0) {}
+        virtual ~bench_path_base_t() {}
+        virtual double compress(void) = 0;
+        virtual double decompress(void) = 0;
+        virtual bool verify(void) = 0;
+    };
+
+    //--- kernel ---
+    // The input is handed over in one piece, the info states the block layer acts on are
+    // gone through. The kernels are allocated out of the timings, their init() is timed.
+    class bench_kernel_encode_action_t {
+    public:
+        typedef double result_t;
+        teleport_t in;
+        location_t out;
+        counters_t &counters;
+
+        bench_kernel_encode_action_t(const std::vector<uint8_t> &data,
+                                     std::vector<uint8_t> &compressed, counters_t &counters):
+            in(1 << 16), counters(counters)
+        {   in.change_input_buffer(data.data(), data.size());
+            out.encapsulate(compressed.data(), compressed.size()); }
+        template<class KERNEL_ENCODE_T>double run(void)
+        {
+            KERNEL_ENCODE_T *kernel_encode = new KERNEL_ENCODE_T();
+            kernel_encode_t::state_t state;
+            counters.start();
+            const bench_clock_t::time_point start = bench_clock_t::now();
+            kernel_encode->init();
+            while ((state = kernel_encode->continue_(&in, &out)) !=
+                   kernel_encode_t::state_stall_on_input)
+                if (state != kernel_encode_t::state_info_new_block &&
+                    state != kernel_encode_t::state_info_efficiency_check) goto error;
+            while ((state = kernel_encode->finish(&in, &out)) != kernel_encode_t::state_ready)
+                if (state != kernel_encode_t::state_info_new_block &&
+                    state != kernel_encode_t::state_info_efficiency_check) goto error;
+                else if (!in.available_bytes()) break;
+            {
+                const double elapsed = bench_elapsed(start);
+                counters.stop();
+                delete kernel_encode;
+                return elapsed;
+            }
+        error:
+            delete kernel_encode;
+            return error();
+        }
+        double error(void) { return -1; }
+    };
+    class bench_kernel_decode_action_t {
+    public:
+        typedef double result_t;
+        teleport_t in;
+        location_t out;
+        main_header_t header;
+        counters_t &counters;
+
+        bench_kernel_decode_action_t(const uint8_t *compressed,
+                                     const uint_fast64_t compressed_size,
+                                     std::vector<uint8_t> &decompressed,
+                                     const compression_mode_t mode, counters_t &counters):
+            in(1 << 16), counters(counters)
+        {   in.change_input_buffer(compressed, compressed_size);
+            out.encapsulate(decompressed.data(), decompressed.size());
+            header.setup(mode, block_type_default); }
+        template<class KERNEL_DECODE_T>double run(void)
+        {
+            KERNEL_DECODE_T *kernel_decode = new KERNEL_DECODE_T();
+            kernel_decode_t::state_t state;
+            counters.start();
+            const bench_clock_t::time_point start = bench_clock_t::now();
+            kernel_decode->init(header.parameters(), 0);
+            while ((state = kernel_decode->continue_(&in, &out)) !=
+                   kernel_decode_t::state_stall_on_input)
+                if (state != kernel_decode_t::state_info_new_block &&
+                    state != kernel_decode_t::state_info_efficiency_check) goto error;
+            while ((state = kernel_decode->finish(&in, &out)) != kernel_decode_t::state_ready)
+                if (state != kernel_decode_t::state_info_new_block &&
+                    state != kernel_decode_t::state_info_efficiency_check) goto error;
+                else if (!in.available_bytes()) break;
+            {
+                const double elapsed = bench_elapsed(start);
+                counters.stop();
+                delete kernel_decode;
+                return elapsed;
+            }
+        error:
+            delete kernel_decode;
+            return error();
+        }
+        double error(void) { return -1; }
+    };
+    class bench_kernel_t: public bench_path_base_t {
+        std::vector<uint8_t> compressed, decompressed;
+        uint_fast64_t decompressed_size;
+    public:
+        // The decoders stall short of the end of their output by decode_output_lookahead.
+        bench_kernel_t(const std::vector<uint8_t> &data, const compression_mode_t mode,
+                       counters_t &counters):
+            bench_path_base_t(data, mode, counters),
+            compressed(compress_bound(data.size(), mode, block_type_default)),
+            decompressed(data.size() + (decode_output_lookahead << 1)),
+            decompressed_size(0) {}
+        double compress(void)
+        {   bench_kernel_encode_action_t action(data, compressed, counters);
+            const double elapsed = dispatch_encode(action, mode, hash_default_bits);
+            compressed_size = action.out.used();
+            return elapsed; }
+        double decompress(void)
+        {   bench_kernel_decode_action_t action(compressed.data(), compressed_size,
+                                                decompressed, mode, counters);
+            const double elapsed = dispatch_decode(action, mode, hash_default_bits);
+            decompressed_size = action.out.used();
+            return elapsed; }
+        bool verify(void)
+        {   return decompressed_size == data.size() &&
+                std::equal(data.begin(), data.end(), decompressed.begin()); }
+    };
+
+    //--- api ---
+    class bench_api_t: public bench_path_base_t {
+        std::vector<uint8_t> compressed, decompressed;
+        uint_fast64_t decompressed_size;
+    public:
+        bench_api_t(const std::vector<uint8_t> &data, const compression_mode_t mode,
+                    counters_t &counters):
+            bench_path_base_t(data, mode, counters),
+            compressed(compress_bound(data.size(), mode, block_type_default)),
+            decompressed(data.size()), decompressed_size(0) {}
+        double compress(void)
+        {   counters.start();
+            const bench_clock_t::time_point start = bench_clock_t::now();
+            const processing_result_t result =
+                density::compress(data.data(), data.size(), compressed.data(),
+                                  compressed.size(), mode, block_type_default);
+            const double elapsed = bench_elapsed(start);
+            counters.stop();
+            compressed_size = result.bytes_written;
+            return result.state ? -1: elapsed; }
+        double decompress(void)
+        {   counters.start();
+            const bench_clock_t::time_point start = bench_clock_t::now();
+            const processing_result_t result =
+                density::decompress(compressed.data(), compressed_size,
+                                    decompressed.data(), decompressed.size());
+            const double elapsed = bench_elapsed(start);
+            counters.stop();
+            decompressed_size = result.bytes_written;
+            return result.state ? -1: elapsed; }
+        bool verify(void)
+        {   return decompressed_size == data.size() &&
+                std::equal(data.begin(), data.end(), decompressed.begin()); }
+    };
+
+    //--- stream ---
+    // Temporary files stand for the streams, they mostly stay in the page cache.
+    const size_t bench_stream_buffer_size = 1 << 19;
+    typedef file_buffer_t<bench_stream_buffer_size,
+                          bench_stream_buffer_size> bench_file_buffer_t;
+    class bench_stream_encode_action_t {
+    public:
+        typedef bool result_t;
+        context_t &context;
+        bench_file_buffer_t &buffer;
+        counters_t &counters;
+        uint32_t relative_position;
+
+        bench_stream_encode_action_t(context_t &context, bench_file_buffer_t &buffer,
+                                     counters_t &counters):
+            context(context), buffer(buffer), counters(counters), relative_position(0) {}
+        template<class BLOCK_T>encode_state_t counted(BLOCK_T *block, const bool finishing)
+        {   counters.start();
+            const encode_state_t encode_state = finishing ?
+                block->finish(context.before()): block->continue_(context.before());
+            counters.stop();
+            return context.after(encode_state); }
+        template<class KERNEL_ENCODE_T>bool run(void)
+        {
+            encode_state_t encode_state;
+            block_encode_t<KERNEL_ENCODE_T> *block_encode =
+                new block_encode_t<KERNEL_ENCODE_T>();
+            bool succeeded = !block_encode->init(context);
+            while (succeeded && (encode_state = counted(block_encode, false)))
+                if (buffer.action(encode_state, context)) succeeded = false;
+                else if (buffer.get_last_read()) break;
+            while (succeeded && (encode_state = counted(block_encode, true)))
+                if (buffer.action(encode_state, context)) succeeded = false;
+            relative_position = block_encode->read_bytes();
+            delete block_encode;
+            return succeeded;
+        }
+        bool error(void) { return false; }
+    };
+    class bench_stream_decode_action_t {
+    public:
+        typedef bool result_t;
+        context_t &context;
+        bench_file_buffer_t &buffer;
+        counters_t &counters;
+
+        bench_stream_decode_action_t(context_t &context, bench_file_buffer_t &buffer,
+                                     counters_t &counters):
+            context(context), buffer(buffer), counters(counters) {}
+        template<class BLOCK_T>decode_state_t counted(BLOCK_T *block, const bool finishing)
+        {   counters.start();
+            const decode_state_t decode_state = finishing ?
+                block->finish(context.before()): block->continue_(context.before());
+            counters.stop();
+            return context.after(decode_state); }
+        template<class KERNEL_DECODE_T>bool run(void)
+        {
+            decode_state_t decode_state;
+            block_decode_t<KERNEL_DECODE_T> *block_decode =
+                new block_decode_t<KERNEL_DECODE_T>();
+            bool succeeded = !block_decode->init(context);
+            while (succeeded && (decode_state = counted(block_decode, false)))
+                if (buffer.action(decode_state, context)) succeeded = false;
+                else if (buffer.get_last_read()) break;
+            while (succeeded && (decode_state = counted(block_decode, true)))
+                if (buffer.action(decode_state, context)) succeeded = false;
+            delete block_decode;
+            return succeeded;
+        }
+        bool error(void) { return false; }
+    };
+    class bench_stream_t: public bench_path_base_t {
+        FILE *original, *compressed, *decompressed;
+        static bool restart(FILE *file)
+        {   rewind(file);
+            return !ftruncate(fileno(file), 0); }
+    public:
+        bench_stream_t(const std::vector<uint8_t> &data, const compression_mode_t mode,
+                       counters_t &counters):
+            bench_path_base_t(data, mode, counters),
+            original(tmpfile()), compressed(tmpfile()), decompressed(tmpfile())
+        {   if (original) fwrite(data.data(), 1, data.size(), original); }
+        ~bench_stream_t()
+        {   if (original) fclose(original);
+            if (compressed) fclose(compressed);
+            if (decompressed) fclose(decompressed); }
+        double compress(void)
+        {
+            if (!original || !compressed || fflush(original) || !restart(compressed))
+                return -1;
+            rewind(original);
+            const bench_clock_t::time_point start = bench_clock_t::now();
+            context_t context;
+            context.integrity_helper = parallel_threads(0) > 1;
+            bench_file_buffer_t *buffer = new bench_file_buffer_t(original, compressed);
+            bench_stream_encode_action_t action(context, *buffer, counters);
+            buffer->init(mode, block_type_default, context);
+            bool succeeded = !buffer->action(encode_state_stall_on_input, context);
+            encode_state_t encode_state;
+            while (succeeded && (encode_state = context.write_header()))
+                if (buffer->action(encode_state, context)) succeeded = false;
+            succeeded = succeeded && dispatch_encode(action, mode, hash_default_bits);
+            while (succeeded && (encode_state = context.write_footer(action.relative_position)))
+                if (buffer->action(encode_state, context)) succeeded = false;
+            succeeded = succeeded && !buffer->action(encode_state_stall_on_output, context) &&
+                !buffer->flush();
+            delete buffer;
+            succeeded = succeeded && !fflush(compressed);
+            const double elapsed = bench_elapsed(start);
+            compressed_size = context.get_total_written();
+            return succeeded ? elapsed: -1;
+        }
+        double decompress(void)
+        {
+            if (!decompressed || !restart(decompressed)) return -1;
+            rewind(compressed);
+            const bench_clock_t::time_point start = bench_clock_t::now();
+            context_t context;
+            context.integrity_helper = parallel_threads(0) > 1;
+            bench_file_buffer_t *buffer = new bench_file_buffer_t(compressed, decompressed);
+            bench_stream_decode_action_t action(context, *buffer, counters);
+            buffer->init(compression_mode_copy, block_type_default, context);
+            bool succeeded = !buffer->action(decode_state_stall_on_input, context);
+            decode_state_t decode_state;
+            while (succeeded && (decode_state = context.read_header()))
+                if (buffer->action(decode_state, context)) succeeded = false;
+            succeeded = succeeded &&
+                dispatch_decode(action, context.header.compression_mode(),
+                                context.header.hash_bits());
+            while (succeeded && (decode_state = context.read_footer()))
+                if (buffer->action(decode_state, context)) succeeded = false;
+            succeeded = succeeded && !buffer->action(decode_state_stall_on_output, context) &&
+                !buffer->flush();
+            delete buffer;
+            succeeded = succeeded && !fflush(decompressed);
+            const double elapsed = bench_elapsed(start);
+            return succeeded ? elapsed: -1;
+        }
+        bool verify(void)
+        {
+            std::vector<uint8_t> back(data.size() + 1);
+            rewind(decompressed);
+            return fread(back.data(), 1, back.size(), decompressed) == data.size() &&
+                std::equal(data.begin(), data.end(), back.begin());
+        }
+    };
+
+    //--- measures ---
+    static bench_path_base_t *
+    bench_path_create(const bench_path_t path, const std::vector<uint8_t> &data,
+                      const compression_mode_t mode, counters_t &counters)
+    {
+        switch (path) {
+        case bench_path_kernel:
+            // The copy mode is done by the block layer, its kernel does nothing.
+            if (mode == compression_mode_copy) return NULL;
+            return new bench_kernel_t(data, mode, counters);
+        case bench_path_api: return new bench_api_t(data, mode, counters);
+        case bench_path_stream: return new bench_stream_t(data, mode, counters);
+        default: return NULL;
+        }
+    }
+    static void
+    bench_events(double *events, const counters_t &counters)
+    {
+        for (uint_fast8_t counter = 0; counter < counter_kinds; ++counter)
+            events[counter] = counters.total((counter_t)counter);
+    }
+    static bool
+    bench_measure(bench_result_t &result, bench_path_base_t &bench,
+                  const unsigned repetitions)
+    {
+        result.compress_seconds = result.decompress_seconds = -1;
+        for (uint_fast8_t counter = 0; counter < counter_kinds; ++counter)
+            result.compress_events[counter] = result.decompress_events[counter] = -1;
+        for (unsigned repetition = 0; repetition < repetitions; ++repetition) {
+            bench.counters.reset();
+            const double elapsed = bench.compress();
+            if (elapsed < 0) return false;
+            if (result.compress_seconds < 0 || elapsed < result.compress_seconds) {
+                result.compress_seconds = elapsed;
+                bench_events(result.compress_events, bench.counters);
+            }
+        }
+        result.compressed = bench.compressed_size;
+        for (unsigned repetition = 0; repetition < repetitions; ++repetition) {
+            bench.counters.reset();
+            const double elapsed = bench.decompress();
+            if (elapsed < 0) return false;
+            if (result.decompress_seconds < 0 || elapsed < result.decompress_seconds) {
+                result.decompress_seconds = elapsed;
+                bench_events(result.decompress_events, bench.counters);
+            }
+        }
+        return result.verified = bench.verify();
+    }
+
+    //--- output ---
+    // Names without their enum prefix.
+    static std::string
+    bench_name(const std::string &rendered, const char *prefix)
+    {   return rendered.substr(strlen(prefix)); }
+    // MB are 10^6 bytes, as in sharcxx.
+    static double
+    bench_speed(const uint_fast64_t size, const double seconds)
+    {   return seconds > 0 ? size / (seconds * 1e6): 0; }
+    // Figures derived from the events of a direction, per byte of the original data or
+    // per thousand instructions (mpki).
+    typedef enum {
+        bench_metric_cycles_per_byte,
+        bench_metric_ipc,
+        bench_metric_branch_miss_rate,
+        bench_metric_l1d_mpki,
+        bench_metric_llc_mpki
+    } bench_metric_t;
+    DENSITY_ENUM_RENDER5(bench_metric, cycles_per_byte, ipc, branch_miss_rate, l1d_mpki,
+                         llc_mpki);
+    const uint_fast8_t bench_metrics = 5;
+    static double
+    bench_ratio(const double numerator, const double denominator, const double scale)
+    {   return numerator >= 0 && denominator > 0 ? numerator * scale / denominator: -1; }
+    // Negative when an event it needs is not counted.
+    static double
+    bench_metric(const bench_metric_t metric, const double *events, const uint_fast64_t size)
+    {
+        switch (metric) {
+        case bench_metric_cycles_per_byte:
+            return bench_ratio(events[counter_cycles], (double)size, 1);
+        case bench_metric_ipc:
+            return bench_ratio(events[counter_instructions], events[counter_cycles], 1);
+        case bench_metric_branch_miss_rate:
+            return bench_ratio(events[counter_branch_misses], events[counter_branches], 1);
+        case bench_metric_l1d_mpki:
+            return bench_ratio(events[counter_l1d_misses], events[counter_instructions], 1000);
+        case bench_metric_llc_mpki:
+            return bench_ratio(events[counter_llc_misses], events[counter_instructions], 1000);
+        default: return -1;
+        }
+    }
+    // The metrics of both directions, empty CSV fields or JSON nulls when not counted.
+    static void
+    bench_write_metrics(FILE *output, const bench_result_t &result, const bool json)
+    {
+        for (uint_fast8_t direction = 0; direction < 2; ++direction)
+            for (uint_fast8_t metric = 0; metric < bench_metrics; ++metric) {
+                const double value =
+                    bench_metric((bench_metric_t)metric, direction ? result.decompress_events:
+                                 result.compress_events, result.size);
+                if (json)
+                    fprintf(output, ", \"%s_%s\": ", direction ? "decompress": "compress",
+                            bench_name(bench_metric_render((bench_metric_t)metric),
+                                       "bench_metric_").c_str());
+                else fprintf(output, ",");
+                if (value >= 0) fprintf(output, "%.4f", value);
+                else if (json) fprintf(output, "null");
+            }
+    }
+    static void
+    bench_write_csv_header(FILE *output)
+    {
+        fprintf(output, "path,mode,corpus,size,compressed,ratio,"
+                "compress_mbps,decompress_mbps,verified");
+        for (uint_fast8_t direction = 0; direction < 2; ++direction)
+            for (uint_fast8_t metric = 0; metric < bench_metrics; ++metric)
+                fprintf(output, ",%s_%s", direction ? "decompress": "compress",
+                        bench_name(bench_metric_render((bench_metric_t)metric),
+                                   "bench_metric_").c_str());
+        fprintf(output, "\n");
+    }
+    static void
+    bench_write_csv(FILE *output, const bench_result_t &result)
+    {
+        fprintf(output, "%s,%s,%s,%llu,%llu,%.4f,%.1f,%.1f,%s",
+                bench_name(bench_path_render(result.path), "bench_path_").c_str(),
+                bench_name(compression_mode_render(result.mode),
+                           "compression_mode_").c_str(),
+                bench_name(corpus_render(result.corpus), "corpus_").c_str(),
+                (unsigned long long)result.size, (unsigned long long)result.compressed,
+                result.size ? (double)result.compressed / result.size: 0,
+                bench_speed(result.size, result.compress_seconds),
+                bench_speed(result.size, result.decompress_seconds),
+                result.verified ? "yes": "no");
+        bench_write_metrics(output, result, false);
+        fprintf(output, "\n");
+    }
+    static void
+    bench_write_json(FILE *output, const bench_result_t &result, const bool first)
+    {
+        fprintf(output, "%s  {\"path\": \"%s\", \"mode\": \"%s\", \"corpus\": \"%s\", "
+                "\"size\": %llu, \"compressed\": %llu, \"ratio\": %.4f, "
+                "\"compress_mbps\": %.1f, \"decompress_mbps\": %.1f, \"verified\": %s",
+                first ? "": ",\n",
+                bench_name(bench_path_render(result.path), "bench_path_").c_str(),
+                bench_name(compression_mode_render(result.mode),
+                           "compression_mode_").c_str(),
+                bench_name(corpus_render(result.corpus), "corpus_").c_str(),
+                (unsigned long long)result.size, (unsigned long long)result.compressed,
+                result.size ? (double)result.compressed / result.size: 0,
+                bench_speed(result.size, result.compress_seconds),
+                bench_speed(result.size, result.decompress_seconds),
+                result.verified ? "true": "false");
+        bench_write_metrics(output, result, true);
+        fprintf(output, "}");
+    }
+
+    static void usage(const char *arg0)
+    {
+        printf("DensityXX %u.%u.%u benchmark\n\n", (unsigned)major_version,
+               (unsigned)minor_version, (unsigned)revision);
+        printf("Usage :\n");
+        printf("  %s [OPTIONS]...\n\n", arg0);
+        printf("Available options :\n");
+        printf("  -p[PATHS]   Paths measured among kernel, api and stream, comma separated\n");
+        printf("              (default all)\n");
+        printf("  -c[LEVELS]  Modes measured, digits of the sharcxx -c levels (default\n");
+        printf("              01234)\n");
+        printf("  -t[CORPORA] Corpora among text, json, zeros, random, floats and mixed,\n");
+        printf("              comma separated (default all)\n");
+        printf("  -s[SIZES]   Input sizes in bytes, k and m suffixes allowed, comma\n");
+        printf("              separated (default 64k,1m,16m)\n");
+        printf("  -r[COUNT]   Repetitions, the best one is kept (default 5)\n");
+        printf("  -g[SEED]    Seed of the corpora (default 1)\n");
+        printf("  -j          Write JSON instead of CSV\n");
+        printf("  -o[FILE]    Write to FILE instead of stdout\n");
+        printf("  -w[DIR]     Write the corpora to DIR as CORPUS-SIZE.bin files instead of\n");
+        printf("              measuring, to give them to sharcxx\n");
+        printf("  -h          Display this help\n");
+        printf("\nThe run fails when a round trip does, or when -c4 compresses worse than the\n");
+        printf("best of -c1, -c2 and -c3 measured by more than 1/%u.\n",
+               (unsigned)adaptive_margin);
+        printf("\nCycles, instructions, branch and cache misses are counted over the calls\n");
+        printf("into the kernels where perf_event_open allows it, their columns are left\n");
+        printf("empty otherwise.\n");
+        exit(0);
+    }
+    // Comma separated items of list, the ones found in names set their bit in the result.
+    static uint_fast32_t
+    bench_parse_names(const char *list, const char *const *names, const uint_fast8_t count,
+                      const char *arg0)
+    {
+        uint_fast32_t selected = 0;
+        std::string items(list);
+        size_t start = 0;
+        while (start <= items.size()) {
+            size_t end = items.find(',', start);
+            if (end == std::string::npos) end = items.size();
+            const std::string item = items.substr(start, end - start);
+            uint_fast8_t idx = 0;
+            while (idx < count && item != names[idx]) ++idx;
+            if (idx == count) usage(arg0);
+            selected |= 1 << idx;
+            start = end + 1;
+        }
+        return selected;
+    }
+    static void
+    bench_parse_sizes(std::vector<uint_fast64_t> &sizes, const char *list, const char *arg0)
+    {
+        sizes.clear();
+        while (*list) {
+            char *end;
+            uint_fast64_t size = strtoull(list, &end, 10);
+            switch (*end) {
+            case 'k': case 'K': size <<= 10; ++end; break;
+            case 'm': case 'M': size <<= 20; ++end; break;
+            default: break;
+            }
+            if (end == list || !size || (*end && *end != ',')) usage(arg0);
+            sizes.push_back(size);
+            list = *end ? end + 1: end;
+        }
+        if (sizes.empty()) usage(arg0);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    static const char *const path_names[] = { "kernel", "api", "stream" };
+    static const char *const corpus_names[] = {
+        "text", "json", "zeros", "random", "floats", "mixed"
+    };
+    uint_fast32_t paths = (1 << density::bench_paths) - 1;
+    uint_fast32_t levels = (1 << density::bench_levels) - 1;
+    uint_fast32_t corpora = (1 << density::corpus_kinds) - 1;
+    std::vector<uint_fast64_t> sizes;
+    sizes.push_back(1 << 16);
+    sizes.push_back(1 << 20);
+    sizes.push_back(1 << 24);
+    unsigned repetitions = 5;
+    uint64_t seed = 1;
+    bool json = false;
+    FILE *output = stdout;
+    const char *corpus_dir = NULL;
+    density::counters_t counters;
+
+    for (int idx = 1; idx < argc; idx++) {
+        if (argv[idx][0] != '-' || strlen(argv[idx]) < 2) density::usage(argv[0]);
+        const char *value = argv[idx] + 2;
+        switch (argv[idx][1]) {
+        case 'p':
+            paths = density::bench_parse_names(value, path_names, density::bench_paths,
+                                               argv[0]);
+            break;
+        case 'c':
+            levels = 0;
+            for (; *value; ++value)
+                if (*value >= '0' && *value < '0' + density::bench_levels)
+                    levels |= 1 << (*value - '0');
+                else density::usage(argv[0]);
+            if (!levels) density::usage(argv[0]);
+            break;
+        case 't':
+            corpora = density::bench_parse_names(value, corpus_names, density::corpus_kinds,
+                                                 argv[0]);
+            break;
+        case 's': density::bench_parse_sizes(sizes, value, argv[0]); break;
+        case 'r':
+            if (!(repetitions = (unsigned)atoi(value))) density::usage(argv[0]);
+            break;
+        case 'g': seed = strtoull(value, NULL, 10); break;
+        case 'j': json = true; break;
+        case 'o':
+            if (!*value || !(output = fopen(value, "w"))) density::usage(argv[0]);
+            break;
+        case 'w':
+            if (!*value) density::usage(argv[0]);
+            corpus_dir = value;
+            break;
+        default: density::usage(argv[0]);
+        }
+    }
+
+    std::vector<uint8_t> data;
+    if (corpus_dir) {
+        for (uint_fast8_t corpus = 0; corpus < density::corpus_kinds; ++corpus) {
+            if (!(corpora & (1 << corpus))) continue;
+            for (size_t size_idx = 0; size_idx < sizes.size(); ++size_idx) {
+                density::corpus_generate(data, (density::corpus_t)corpus, sizes[size_idx],
+                                         seed);
+                char name[64];
+                snprintf(name, sizeof(name), "/%s-%llu.bin", corpus_names[corpus],
+                         (unsigned long long)sizes[size_idx]);
+                const std::string path = std::string(corpus_dir) + name;
+                FILE *file = fopen(path.c_str(), "wb");
+                if (!file || fwrite(&data[0], 1, data.size(), file) != data.size() ||
+                    fclose(file)) {
+                    fprintf(stderr, "Unable to write %s\n", path.c_str());
+                    return 1;
+                }
+            }
+        }
+        return 0;
+    }
+    if (!counters.available())
+        fprintf(stderr, "Hardware counters unavailable, only the times are measured.\n");
+    if (json) fprintf(output, "[\n");
+    else density::bench_write_csv_header(output);
+    bool first = true, verified = true;
+    for (uint_fast8_t corpus = 0; corpus < density::corpus_kinds; ++corpus) {
+        if (!(corpora & (1 << corpus))) continue;
+        for (size_t size_idx = 0; size_idx < sizes.size(); ++size_idx) {
+            density::corpus_generate(data, (density::corpus_t)corpus, sizes[size_idx], seed);
+            for (uint_fast8_t path = 0; path < density::bench_paths; ++path) {
+                if (!(paths & (1 << path))) continue;
+                uint_fast64_t best_kernel = 0, adaptive = 0;
+                for (uint_fast8_t level = 0; level < density::bench_levels; ++level) {
+                    if (!(levels & (1 << level))) continue;
+                    const density::compression_mode_t mode = density::bench_modes[level];
+                    density::bench_path_base_t *bench =
+                        density::bench_path_create((density::bench_path_t)path, data, mode,
+                                                   counters);
+                    if (!bench) continue;
+                    density::bench_result_t result;
+                    result.path = (density::bench_path_t)path;
+                    result.mode = mode;
+                    result.corpus = (density::corpus_t)corpus;
+                    result.size = data.size();
+                    result.compressed = 0;
+                    result.verified = false;
+                    if (!density::bench_measure(result, *bench, repetitions)) verified = false;
+                    delete bench;
+                    if (mode == density::compression_mode_adaptive) adaptive = result.compressed;
+                    else if (mode != density::compression_mode_copy && result.compressed &&
+                             (!best_kernel || result.compressed < best_kernel))
+                        best_kernel = result.compressed;
+                    if (json) density::bench_write_json(output, result, first);
+                    else density::bench_write_csv(output, result);
+                    fflush(output);
+                    first = false;
+                }
+                // Without a minimum speed, the adaptive kernel stays within this margin of the
+                // best kernel.
+                if (adaptive && best_kernel &&
+                    adaptive > best_kernel + best_kernel / density::adaptive_margin) {
+                    fprintf(stderr, "%s %s %llu: -c4 compressed to %llu bytes, the best "
+                            "kernel to %llu\n", path_names[path], corpus_names[corpus],
+                            (unsigned long long)data.size(), (unsigned long long)adaptive,
+                            (unsigned long long)best_kernel);
+                    verified = false;
+                }
+            }
+        }
+    }
+    if (json) fprintf(output, "\n]\n");
+    if (output != stdout) fclose(output);
+    // A failed round trip fails the run, so does -c4 falling behind the best kernel by more
+    // than its margin, the figures are printed all the same.
+    return verified ? 0: 1;
+}
@@ -0,0 +1,136 @@
+// see LICENSE.md for license.
+#include <string>
+#include "benchxx/corpus.hpp"
+
+namespace density {
+    static const char *corpus_syllables[] = {
+        "the", "an", "re", "in", "er", "on", "at", "en", "nd", "ti", "es", "or", "te", "of",
+        "ed", "is", "it", "al", "ar", "st", "to", "nt", "ng", "se", "ha", "as", "ou", "io",
+        "le", "ve", "co", "me", "de", "hi", "ri", "ro", "ic", "ne", "ea", "ra", "ce", "li"
+    };
+    static const uint32_t corpus_syllables_count =
+        sizeof(corpus_syllables) / sizeof(corpus_syllables[0]);
+    static const uint32_t corpus_vocabulary_size = 4096;
+
+    // Words of one to four syllables, the vocabulary depends on the seed too.
+    static void
+    corpus_vocabulary(std::vector<std::string> &vocabulary, corpus_random_t &random)
+    {
+        vocabulary.resize(corpus_vocabulary_size);
+        for (uint32_t idx = 0; idx < corpus_vocabulary_size; ++idx) {
+            const uint32_t syllables = 1 + random.below(4);
+            for (uint32_t count = 0; count < syllables; ++count)
+                vocabulary[idx] += corpus_syllables[random.below(corpus_syllables_count)];
+        }
+    }
+    // Low ranks are drawn far more often, as in natural languages.
+    static const std::string &
+    corpus_word(const std::vector<std::string> &vocabulary, corpus_random_t &random)
+    {
+        uint64_t rank = random.below(corpus_vocabulary_size);
+        rank = rank * rank / corpus_vocabulary_size * rank / corpus_vocabulary_size;
+        return vocabulary[rank];
+    }
+
+    static void
+    corpus_text_generate(std::vector<uint8_t> &data, const uint_fast64_t size,
+                         corpus_random_t &random)
+    {
+        std::vector<std::string> vocabulary;
+        corpus_vocabulary(vocabulary, random);
+        bool sentence_start = true;
+        uint32_t sentences = 0;
+        while (data.size() < size) {
+            std::string word = corpus_word(vocabulary, random);
+            if (sentence_start) word[0] = word[0] - 'a' + 'A';
+            data.insert(data.end(), word.begin(), word.end());
+            sentence_start = !random.below(12);
+            if (!sentence_start) {
+                data.push_back(random.below(10) ? ' ': ',');
+                if (data.back() == ',') data.push_back(' ');
+            } else if (++sentences % 6) {
+                data.push_back('.');
+                data.push_back(' ');
+            } else {
+                data.push_back('.');
+                data.push_back('\n');
+            }
+        }
+    }
+    static void
+    corpus_json_generate(std::vector<uint8_t> &data, const uint_fast64_t size,
+                         corpus_random_t &random)
+    {
+        std::vector<std::string> vocabulary;
+        corpus_vocabulary(vocabulary, random);
+        char record[512];
+        for (uint32_t id = 1; data.size() < size; ++id) {
+            const std::string &user = corpus_word(vocabulary, random);
+            const std::string &domain = corpus_word(vocabulary, random);
+            const int length =
+                snprintf(record, sizeof(record),
+                         "{\"id\":%u,\"user\":\"%s\",\"email\":\"%s@%s.com\","
+                         "\"active\":%s,\"score\":%u.%02u,\"tags\":[\"%s\",\"%s\"]}\n",
+                         (unsigned)id, user.c_str(), user.c_str(), domain.c_str(),
+                         random.below(4) ? "true": "false",
+                         (unsigned)random.below(1000), (unsigned)random.below(100),
+                         corpus_word(vocabulary, random).c_str(),
+                         corpus_word(vocabulary, random).c_str());
+            data.insert(data.end(), record, record + length);
+        }
+    }
+    static void
+    corpus_random_generate(std::vector<uint8_t> &data, const uint_fast64_t size,
+                           corpus_random_t &random)
+    {
+        while (data.size() < size) {
+            const uint64_t value = random.next();
+            for (uint_fast8_t idx = 0; idx < sizeof(value); ++idx)
+                data.push_back((uint8_t)(value >> (idx << 3)));
+        }
+    }
+    // Sensor like series, steps of at most 1/100 from one value to the next.
+    static void
+    corpus_floats_generate(std::vector<uint8_t> &data, const uint_fast64_t size,
+                           corpus_random_t &random)
+    {
+        float value = (float)random.below(1000);
+        while (data.size() < size) {
+            value += ((int32_t)random.below(2001) - 1000) * 1e-5f;
+            uint32_t bits;
+            DENSITY_MEMCPY(&bits, &value, sizeof(bits));
+            for (uint_fast8_t idx = 0; idx < sizeof(bits); ++idx)
+                data.push_back((uint8_t)(bits >> (idx << 3)));
+        }
+    }
+    // Pieces of 4KB to 64KB, every kind in turn.
+    static void
+    corpus_mixed_generate(std::vector<uint8_t> &data, const uint_fast64_t size,
+                          corpus_random_t &random)
+    {
+        std::vector<uint8_t> piece;
+        for (uint_fast8_t kind = 0; data.size() < size; kind = (kind + 1) % corpus_mixed) {
+            const uint_fast64_t piece_size = (uint_fast64_t)4096 << random.below(5);
+            corpus_generate(piece, (corpus_t)kind, piece_size, random.next());
+            data.insert(data.end(), piece.begin(), piece.end());
+        }
+    }
+
+    void
+    corpus_generate(std::vector<uint8_t> &data, const corpus_t corpus,
+                    const uint_fast64_t size, const uint64_t seed)
+    {
+        corpus_random_t random(seed);
+        data.clear();
+        data.reserve(size + 512);
+        switch (corpus) {
+        case corpus_text: corpus_text_generate(data, size, random); break;
+        case corpus_json: corpus_json_generate(data, size, random); break;
+        case corpus_zeros: data.resize(size); break;
+        case corpus_random: corpus_random_generate(data, size, random); break;
+        case corpus_floats: corpus_floats_generate(data, size, random); break;
+        case corpus_mixed: corpus_mixed_generate(data, size, random); break;
+        }
+        data.resize(size);
+    }
+}
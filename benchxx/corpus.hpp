@@ -0,0 +1,39 @@
+// see LICENSE.md for license.
+#pragma once
+
+#include <vector>
+#include "densityxx/globals.hpp"
+
+namespace density {
+    // Synthetic inputs standing for the data the kernels are used on, the same seed gives
+    // the same bytes on every host, so runs on different machines or trees compare.
+    typedef enum {
+        corpus_text,            // Words of a skewed vocabulary, in sentences and lines
+        corpus_json,            // Records of a few typed fields, one per line
+        corpus_zeros,           // Nothing but zero bytes
+        corpus_random,          // Uniformly random bytes, incompressible
+        corpus_floats,          // Little endian float32 random walks
+        corpus_mixed            // Pieces of all the above in turn
+    } corpus_t;
+    DENSITY_ENUM_RENDER6(corpus, text, json, zeros, random, floats, mixed);
+    const uint_fast8_t corpus_kinds = 6;
+
+    // xorshift64*, fast and good enough to shape data.
+    class corpus_random_t {
+        uint64_t state;
+    public:
+        inline corpus_random_t(const uint64_t seed): state(seed ? seed: 1) {}
+        inline uint64_t next(void)
+        {   state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return state * 2685821657736338717ULL; }
+        // Uniform in [0, bound).
+        inline uint32_t below(const uint32_t bound)
+        {   return (uint32_t)(((next() >> 32) * bound) >> 32); }
+    };
+
+    // Fills data with size bytes of corpus.
+    void corpus_generate(std::vector<uint8_t> &data, const corpus_t corpus,
+                         const uint_fast64_t size, const uint64_t seed);
+}
@@ -0,0 +1,104 @@
+// see LICENSE.md for license.
+#include "benchxx/counters.hpp"
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace density {
+#ifdef __linux__
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } counter_events[counter_kinds] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) }
+    };
+#endif
+
+    counters_t::counters_t(void)
+    {
+        for (uint_fast8_t counter = 0; counter < counter_kinds; ++counter) {
+            descriptors[counter] = -1;
+#ifdef __linux__
+            struct perf_event_attr attributes;
+            memset(&attributes, 0, sizeof(attributes));
+            attributes.size = sizeof(attributes);
+            attributes.type = counter_events[counter].type;
+            attributes.config = counter_events[counter].config;
+            attributes.read_format =
+                PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            // Left running, the regions are told apart by reading the counts.
+            descriptors[counter] =
+                (int)syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+#endif
+        }
+        reset();
+    }
+    counters_t::~counters_t()
+    {
+#ifdef __linux__
+        for (uint_fast8_t counter = 0; counter < counter_kinds; ++counter)
+            if (descriptors[counter] >= 0) close(descriptors[counter]);
+#endif
+    }
+    bool
+    counters_t::available(void) const
+    {
+        for (uint_fast8_t counter = 0; counter < counter_kinds; ++counter)
+            if (descriptors[counter] >= 0) return true;
+        return false;
+    }
+    bool
+    counters_t::read(const uint_fast8_t counter, reading_t &reading) const
+    {
+#ifdef __linux__
+        return descriptors[counter] >= 0 &&
+            ::read(descriptors[counter], &reading, sizeof(reading)) == sizeof(reading);
+#else
+        return false;
+#endif
+    }
+    void
+    counters_t::reset(void)
+    {
+        for (uint_fast8_t counter = 0; counter < counter_kinds; ++counter)
+            totals[counter] = descriptors[counter] >= 0 ? 0: -1;
+    }
+    void
+    counters_t::start(void)
+    {
+        for (uint_fast8_t counter = 0; counter < counter_kinds; ++counter)
+            if (descriptors[counter] >= 0 && !read(counter, starts[counter]))
+                totals[counter] = -1;
+    }
+    void
+    counters_t::stop(void)
+    {
+        reading_t stop;
+        for (uint_fast8_t counter = 0; counter < counter_kinds; ++counter) {
+            if (totals[counter] < 0) continue;
+            if (!read(counter, stop)) {
+                totals[counter] = -1;
+                continue;
+            }
+            const uint64_t running = stop.running - starts[counter].running;
+            const uint64_t enabled = stop.enabled - starts[counter].enabled;
+            if (running)
+                totals[counter] += (double)(stop.value - starts[counter].value) *
+                    enabled / running;
+        }
+    }
+    double
+    counters_t::total(const counter_t counter) const
+    {   return totals[counter]; }
+}
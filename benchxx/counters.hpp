@@ -0,0 +1,48 @@
+// see LICENSE.md for license.
+#pragma once
+
+#include "densityxx/globals.hpp"
+
+namespace density {
+    // Hardware events of the calling thread, in user space, counted by perf_event_open on
+    // Linux. The events the processor, the kernel or the container does not let us count
+    // are left out, all of them elsewhere.
+    typedef enum {
+        counter_cycles,
+        counter_instructions,
+        counter_branches,
+        counter_branch_misses,
+        counter_l1d_misses,         // Level 1 data cache read misses
+        counter_llc_misses          // Last level cache read misses
+    } counter_t;
+    DENSITY_ENUM_RENDER6(counter, cycles, instructions, branches, branch_misses,
+                         l1d_misses, llc_misses);
+    const uint_fast8_t counter_kinds = 6;
+
+    // Every event is opened on its own, a group would only count when all of them can.
+    class counters_t {
+    public:
+        counters_t(void);
+        ~counters_t();
+        // Whether any event is counted.
+        bool available(void) const;
+        // The events are added up over the regions from start() to stop() since reset().
+        void reset(void);
+        void start(void);
+        void stop(void);
+        // Total of an event, scaled up when the kernel had it share the hardware with
+        // others, negative when it is not counted.
+        double total(const counter_t counter) const;
+    private:
+        struct reading_t {
+            uint64_t value, enabled, running;
+        };
+        int descriptors[counter_kinds];
+        reading_t starts[counter_kinds];
+        double totals[counter_kinds];
+
+        bool read(const uint_fast8_t counter, reading_t &reading) const;
+        counters_t(const counters_t &);
+        counters_t &operator=(const counters_t &);
+    };
+}
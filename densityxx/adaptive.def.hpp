@@ -0,0 +1,126 @@
+// see LICENSE.md for license.
+#pragma once
+#include <chrono>
+#include <cmath>
+#include "densityxx/chameleon.def.hpp"
+#include "densityxx/cheetah.def.hpp"
+#include "densityxx/lion.def.hpp"
+
+namespace density {
+    // Kernels compression_mode_adaptive switches among, from the fastest to the strongest.
+    const uint_fast8_t adaptive_kernels = 3;
+    // The kernels are compared on the first adaptive_sample_size bytes of a block, no more
+    // than the staging buffer of a teleport_t holds while waiting for them.
+    const uint_fast64_t adaptive_sample_size = 1 << 16;
+
+#pragma pack(push)
+#pragma pack(4)
+    //--- encode ---
+    // Fresh kernels trial encoding a sample into output, they are judged on the same data
+    // and from the same cold start.
+    template<uint_fast8_t HASH_BITS>class adaptive_trial_t {
+    public:
+        DENSITY_INLINE adaptive_trial_t(void): in(adaptive_sample_size) {}
+
+        teleport_t in;
+        location_t out;
+        chameleon_encode_t<HASH_BITS> chameleon;
+        cheetah_encode_t<HASH_BITS> cheetah;
+        lion_encode_t<HASH_BITS> lion;
+        uint8_t output[adaptive_sample_size << 1];
+    };
+
+    // Every block is encoded by one of the dictionary kernels, named by a
+    // block_mode_marker_t at its start. The kernels keep their dictionaries from block to
+    // block, whether they are used or not in between.
+    template<uint_fast8_t HASH_BITS, class STATS_T = stats_off_t>
+    class adaptive_encode_t: public kernel_encode_t {
+    public:
+        DENSITY_INLINE adaptive_encode_t(void): trial(NULL) {}
+        DENSITY_INLINE ~adaptive_encode_t() { delete trial; }
+        DENSITY_INLINE compression_mode_t mode(void) const
+        {   return compression_mode_adaptive; }
+        DENSITY_INLINE void set_minimum_speed(const double minimum_speed)
+        {   this->minimum_speed = minimum_speed; }
+
+        state_t init(void);
+        state_t continue_(teleport_t *in, location_t *out);
+        state_t finish(teleport_t *in, location_t *out);
+        DENSITY_INLINE void set_stats(stats_t *counters)
+        {   stats.attach(counters);
+            chameleon.set_stats(counters);
+            cheetah.set_stats(counters);
+            lion.set_stats(counters); }
+        // Also counted in by the block encoder.
+        STATS_T stats;
+    private:
+        typedef enum {
+            process_write_mode_marker,
+            process_encode,
+        } process_t;
+        DENSITY_ENUM_RENDER2(process, write_mode_marker, encode);
+
+        // Output bytes per input byte and input bytes per second of a kernel over the last
+        // sample it has trial encoded, ratio is negative until there is one.
+        struct measure_t {
+            double ratio, speed;
+        };
+
+        process_t process;
+        compression_mode_t current_mode;
+        measure_t measures[adaptive_kernels];
+        uint_fast64_t blocks;
+        double minimum_speed;
+        // Ratio of the last block of current_mode, negative after a trial. The kernels are
+        // trialled again at the next block when it moves too much.
+        double last_ratio;
+        bool retry;
+
+        // current block.
+        uint_fast64_t block_read, block_written;
+
+        chameleon_encode_t<HASH_BITS, STATS_T> chameleon;
+        cheetah_encode_t<HASH_BITS, STATS_T> cheetah;
+        lion_encode_t<HASH_BITS, STATS_T> lion;
+        adaptive_trial_t<HASH_BITS> *trial;
+
+        template<class KERNEL_ENCODE_T>void
+        trial_encode(KERNEL_ENCODE_T &kernel, measure_t &measure,
+                     const uint8_t *sample, const uint_fast64_t szsample);
+        void trial_encode(const uint8_t *sample, const uint_fast64_t szsample);
+        compression_mode_t select_mode(void) const;
+        void measure(void);
+        state_t encode(teleport_t *in, location_t *out, const bool finishing);
+        adaptive_encode_t(const adaptive_encode_t &);
+        adaptive_encode_t &operator=(const adaptive_encode_t &);
+    };
+
+    //--- decode ---
+    template<uint_fast8_t HASH_BITS>class adaptive_decode_t: public kernel_decode_t {
+    public:
+        DENSITY_INLINE compression_mode_t mode(void) const
+        {   return compression_mode_adaptive; }
+
+        state_t init(const main_header_parameters_t parameters,
+                     const uint_fast8_t end_data_overhead);
+        state_t continue_(teleport_t *in, location_t *out);
+        state_t finish(teleport_t *in, location_t *out);
+    private:
+        typedef enum {
+            process_read_mode_marker,
+            process_decode,
+        } process_t;
+        DENSITY_ENUM_RENDER2(process, read_mode_marker, decode);
+
+        process_t process;
+        compression_mode_t current_mode;
+        uint_fast8_t end_data_overhead;
+
+        chameleon_decode_t<HASH_BITS> chameleon;
+        cheetah_decode_t<HASH_BITS> cheetah;
+        lion_decode_t<HASH_BITS> lion;
+
+        state_t decode(teleport_t *in, location_t *out, const bool finishing);
+    };
+#pragma pack(pop)
+}
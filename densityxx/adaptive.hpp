@@ -0,0 +1,201 @@
+// see LICENSE.md for license.
+#pragma once
+#include "densityxx/adaptive.def.hpp"
+
+namespace density {
+    // The kernels are trialled again on one block out of adaptive_probe_blocks, or as soon
+    // as the ratio of the kernel in use moves by more than 1/adaptive_change. A faster
+    // kernel is only picked when it saves more than 1/adaptive_margin of the output of a
+    // stronger one: starting cold on a sample, the stronger kernels are underrated.
+    const uint_fast64_t adaptive_probe_blocks = 32;
+    const uint_fast64_t adaptive_margin = 32;
+    const uint_fast64_t adaptive_change = 4;
+    static const compression_mode_t adaptive_modes[adaptive_kernels] = {
+        compression_mode_chameleon_algorithm, compression_mode_cheetah_algorithm,
+        compression_mode_lion_algorithm
+    };
+
+    //--- encode ---
+    template<uint_fast8_t HASH_BITS, class STATS_T>
+    template<class KERNEL_ENCODE_T> DENSITY_INLINE void
+    adaptive_encode_t<HASH_BITS, STATS_T>::trial_encode(KERNEL_ENCODE_T &kernel,
+                                                        measure_t &measure,
+                                                        const uint8_t *sample,
+                                                        const uint_fast64_t szsample)
+    {
+        kernel_encode_t::state_t kernel_encode_state;
+        trial->in.reset_staging_buffer();
+        trial->in.change_input_buffer(sample, szsample);
+        trial->out.encapsulate(trial->output, sizeof(trial->output));
+        kernel.init();
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        do kernel_encode_state = kernel.continue_(&trial->in, &trial->out);
+        while (kernel_encode_state == state_info_new_block ||
+               kernel_encode_state == state_info_efficiency_check);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const uint_fast64_t read = szsample - trial->in.available_bytes();
+        // Less than a unit of the kernel, the previous measure is kept.
+        if (!read) return;
+        measure.ratio = (double)trial->out.used() / read;
+        measure.speed = elapsed.count() > 0 ? read / elapsed.count(): read * 1e9;
+    }
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    adaptive_encode_t<HASH_BITS, STATS_T>::trial_encode(const uint8_t *sample,
+                                                        const uint_fast64_t szsample)
+    {
+        if (!trial) trial = new adaptive_trial_t<HASH_BITS>();
+        trial_encode(trial->chameleon, measures[0], sample, szsample);
+        trial_encode(trial->cheetah, measures[1], sample, szsample);
+        trial_encode(trial->lion, measures[2], sample, szsample);
+        last_ratio = -1;
+        retry = false;
+    }
+    // Without a minimum speed, the choice only depends on the data and so does the output.
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE compression_mode_t
+    adaptive_encode_t<HASH_BITS, STATS_T>::select_mode(void) const
+    {
+        uint_fast8_t best = adaptive_kernels;
+        for (uint_fast8_t idx = adaptive_kernels; idx-- > 0;) {
+            if (measures[idx].ratio < 0) continue;
+            if (minimum_speed > 0 && measures[idx].speed < minimum_speed * 1e6) continue;
+            if (best == adaptive_kernels || measures[idx].ratio +
+                measures[best].ratio / adaptive_margin < measures[best].ratio) best = idx;
+        }
+        // None is fast enough, the fastest is the closest.
+        if (best == adaptive_kernels) best = 0;
+        return adaptive_modes[best];
+    }
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    adaptive_encode_t<HASH_BITS, STATS_T>::measure(void)
+    {
+        ++blocks;
+        if (!block_read) return;
+        const double ratio = (double)block_written / block_read;
+        // The data has changed, the kernels are trialled again.
+        if (last_ratio >= 0 && std::abs(ratio - last_ratio) * adaptive_change > last_ratio)
+            retry = true;
+        last_ratio = ratio;
+    }
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    adaptive_encode_t<HASH_BITS, STATS_T>::encode(teleport_t *in, location_t *out,
+                                                  const bool finishing)
+    {
+        state_t kernel_encode_state;
+        if (process == process_write_mode_marker) {
+            block_mode_marker_t block_mode_marker;
+            if (sizeof(block_mode_marker) > out->available_bytes) return state_stall_on_output;
+            if (retry || blocks % adaptive_probe_blocks == 0) {
+                // The sample is waited for like a unit of the kernels, short of the end.
+                location_t *sample;
+                if (!(sample = in->read(adaptive_sample_size))) {
+                    if (!finishing) return state_stall_on_input;
+                    sample = in->read(in->available_bytes());
+                }
+                trial_encode(sample->pointer, std::min(sample->available_bytes,
+                                                       adaptive_sample_size));
+                current_mode = select_mode();
+            }
+            stats.adaptive_block(current_mode - compression_mode_chameleon_algorithm);
+            block_mode_marker.write(out, current_mode);
+            block_read = block_written = 0;
+            process = process_encode;
+        }
+        const uint_fast64_t available_in_before = in->available_bytes();
+        const uint_fast64_t available_out_before = out->available_bytes;
+        switch (current_mode) {
+        case compression_mode_chameleon_algorithm:
+            kernel_encode_state = finishing ? chameleon.finish(in, out):
+                chameleon.continue_(in, out);
+            break;
+        case compression_mode_cheetah_algorithm:
+            kernel_encode_state = finishing ? cheetah.finish(in, out):
+                cheetah.continue_(in, out);
+            break;
+        case compression_mode_lion_algorithm:
+            kernel_encode_state = finishing ? lion.finish(in, out): lion.continue_(in, out);
+            break;
+        default: return state_error;
+        }
+        block_read += available_in_before - in->available_bytes();
+        block_written += available_out_before - out->available_bytes;
+        if (kernel_encode_state == state_info_new_block) {
+            measure();
+            process = process_write_mode_marker;
+        }
+        return kernel_encode_state;
+    }
+
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    adaptive_encode_t<HASH_BITS, STATS_T>::init(void)
+    {
+        for (uint_fast8_t idx = 0; idx < adaptive_kernels; ++idx)
+            measures[idx].ratio = measures[idx].speed = -1;
+        blocks = 0;
+        last_ratio = -1;
+        retry = false;
+        current_mode = compression_mode_chameleon_algorithm;
+        chameleon.init();
+        cheetah.init();
+        lion.init();
+        process = process_write_mode_marker;
+        return state_ready;
+    }
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    adaptive_encode_t<HASH_BITS, STATS_T>::continue_(teleport_t *in, location_t *out)
+    {   return encode(in, out, false); }
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    adaptive_encode_t<HASH_BITS, STATS_T>::finish(teleport_t *in, location_t *out)
+    {   return encode(in, out, true); }
+
+    //--- decode ---
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    adaptive_decode_t<HASH_BITS>::decode(teleport_t *in, location_t *out, const bool finishing)
+    {
+        state_t kernel_decode_state;
+        if (process == process_read_mode_marker) {
+            block_mode_marker_t block_mode_marker;
+            location_t *read_location;
+            // The encoder starts every block it is given with a marker.
+            if (!(read_location = in->read_reserved(sizeof(block_mode_marker),
+                                                    end_data_overhead)))
+                return finishing ? state_error: state_stall_on_input;
+            block_mode_marker.read(read_location);
+            current_mode = (compression_mode_t)block_mode_marker.mode;
+            process = process_decode;
+        }
+        switch (current_mode) {
+        case compression_mode_chameleon_algorithm:
+            kernel_decode_state = finishing ? chameleon.finish(in, out):
+                chameleon.continue_(in, out);
+            break;
+        case compression_mode_cheetah_algorithm:
+            kernel_decode_state = finishing ? cheetah.finish(in, out):
+                cheetah.continue_(in, out);
+            break;
+        case compression_mode_lion_algorithm:
+            kernel_decode_state = finishing ? lion.finish(in, out): lion.continue_(in, out);
+            break;
+        default: return state_error;
+        }
+        if (kernel_decode_state == state_info_new_block) process = process_read_mode_marker;
+        return kernel_decode_state;
+    }
+
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    adaptive_decode_t<HASH_BITS>::init(const main_header_parameters_t parameters,
+                                       const uint_fast8_t end_data_overhead)
+    {
+        this->end_data_overhead = end_data_overhead;
+        chameleon.init(parameters, end_data_overhead);
+        cheetah.init(parameters, end_data_overhead);
+        lion.init(parameters, end_data_overhead);
+        process = process_read_mode_marker;
+        return state_ready;
+    }
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    adaptive_decode_t<HASH_BITS>::continue_(teleport_t *in, location_t *out)
+    {   return decode(in, out, false); }
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    adaptive_decode_t<HASH_BITS>::finish(teleport_t *in, location_t *out)
+    {   return decode(in, out, true); }
+}
@@ -1,6 +1,7 @@
 // see LICENSE.md for license.
 #pragma once
 #include "densityxx/globals.hpp"
+#include "densityxx/stats.hpp"
 
 namespace density {
     // buffer.
@@ -18,12 +19,130 @@ namespace density {
         uint_fast64_t bytes_read, bytes_written;
     };
 
+    // hash_bits (even, hash_minimum_bits to hash_maximum_bits) sets the dictionary size,
+    // smaller dictionaries stay in cache, larger ones find more matches.
     processing_result_t
     compress(const uint8_t *in, const uint_fast64_t szin,
              uint8_t *out, const uint_fast64_t szout,
              const compression_mode_t compression_mode,
-             const block_type_t block_type);
+             const block_type_t block_type,
+             const uint_fast8_t hash_bits = hash_default_bits);
     processing_result_t
     decompress(const uint8_t *in, const uint_fast64_t szin,
                uint8_t *out, const uint_fast64_t szout);
+    // Kernel picked for an input by trial compressing samples of it with every kernel: the
+    // one compressing best among those running at minimum_speed MB/s at least (0 = no
+    // minimum, then the choice only depends on the data), copy when nothing compresses.
+    // compression_mode_auto stands for this choice, with no minimum unless an encoder_t is
+    // given one.
+    compression_mode_t
+    select_compression_mode(const uint8_t *in, const uint_fast64_t szin,
+                            const double minimum_speed = 0);
+    // Decompressed size recorded in the header of a stream by compress() and
+    // compress_parallel(), content_size_unknown if there is none.
+    const uint_fast64_t content_size_unknown = ~(uint_fast64_t)0;
+    uint_fast64_t
+    get_decompressed_size(const uint8_t *in, const uint_fast64_t szin);
+    // Largest output compress() can produce, an output buffer of this size never falls short.
+    uint_fast64_t
+    compress_bound(const uint_fast64_t szin, const compression_mode_t compression_mode,
+                   const block_type_t block_type);
+
+    // Compress on a pool of threads (0 = one per core), the input is cut into segments of
+    // 2^segment_shift bytes (0 = automatic) compressed independently of each other.
+    // With index, a seek index of the segments is written before the main footer.
+    processing_result_t
+    compress_parallel(const uint8_t *in, const uint_fast64_t szin,
+                      uint8_t *out, const uint_fast64_t szout,
+                      const compression_mode_t compression_mode,
+                      const block_type_t block_type,
+                      unsigned threads = 0, uint_fast8_t segment_shift = 0,
+                      const bool index = false);
+    // Largest output compress_parallel() can produce with the same segment_shift and index,
+    // an automatic segment_shift is taken at its smallest. 0 for an invalid segment_shift.
+    uint_fast64_t
+    compress_parallel_bound(const uint_fast64_t szin, const compression_mode_t compression_mode,
+                            const block_type_t block_type, uint_fast8_t segment_shift = 0,
+                            const bool index = false);
+
+    // Decompress the segments of a stream produced by compress_parallel on a pool of
+    // threads (0 = one per core), other streams are decompressed serially.
+    processing_result_t
+    decompress_parallel(const uint8_t *in, const uint_fast64_t szin,
+                        uint8_t *out, const uint_fast64_t szout,
+                        const unsigned threads = 0);
+
+    // Decompress length bytes of the original data from offset on, out of a segmented
+    // stream, starting from the nearest segment. Reading past the end is not an error, the
+    // number of bytes available is returned in bytes_written.
+    processing_result_t
+    decompress_range(const uint8_t *in, const uint_fast64_t szin,
+                     uint8_t *out, const uint_fast64_t szout,
+                     const uint_fast64_t offset, const uint_fast64_t length);
+
+    // Reusable compression objects, the block encoder/decoder of the last kernel and hash
+    // width used is kept from call to call, the free functions above use throwaway ones.
+    class context_t;
+
+    class encoder_t {
+    public:
+        encoder_t(void);
+        ~encoder_t();
+        // Kernels picked by compression_mode_auto and compression_mode_adaptive run at
+        // minimum_speed MB/s at least (0 = no minimum, the default).
+        void set_minimum_speed(const double minimum_speed);
+        // The input is filtered as arrays of element_size (2, 4 or 8) bytes numbers before
+        // being compressed, decompress() undoes the filter.
+        void set_filter(const filter_t filter, const uint_fast8_t element_size = 4);
+        // The blocks and kernels of the next calls are counted in stats (NULL = none, the
+        // default), the encoding itself is the same.
+        void set_stats(stats_t *stats);
+        processing_result_t
+        compress(const uint8_t *in, const uint_fast64_t szin,
+                 uint8_t *out, const uint_fast64_t szout,
+                 const compression_mode_t compression_mode,
+                 const block_type_t block_type,
+                 const uint_fast8_t hash_bits = hash_default_bits);
+    private:
+        context_t *context;
+        void *block_encode;
+        void (*release)(void *);
+        stats_t *stats;
+        encoder_t(const encoder_t &);
+        encoder_t &operator=(const encoder_t &);
+    };
+    class decoder_t {
+    public:
+        decoder_t(void);
+        ~decoder_t();
+        processing_result_t
+        decompress(const uint8_t *in, const uint_fast64_t szin,
+                   uint8_t *out, const uint_fast64_t szout);
+    private:
+        context_t *context;
+        void *block_decode;
+        void (*release)(void *);
+        decoder_t(const decoder_t &);
+        decoder_t &operator=(const decoder_t &);
+    };
+
+    // Batches of small independent messages, every thread (0 = one per core) keeps one
+    // encoder_t/decoder_t for all the messages it takes. The result of each message is
+    // stored in it, the state of the first failing one is returned.
+    struct batch_message_t {
+        const uint8_t *in;
+        uint_fast64_t szin;
+        uint8_t *out;
+        uint_fast64_t szout;
+        processing_result_t result;
+    };
+    state_t
+    compress_batch(batch_message_t *messages, const uint_fast64_t count,
+                   const compression_mode_t compression_mode,
+                   const block_type_t block_type,
+                   unsigned threads = 1,
+                   const uint_fast8_t hash_bits = hash_default_bits);
+    state_t
+    decompress_batch(batch_message_t *messages, const uint_fast64_t count,
+                     unsigned threads = 1);
 }
@@ -1,7 +1,12 @@
 // see LICENSE.md for license.
+#include <algorithm>
+#include <chrono>
 #include "densityxx/api.def.hpp"
 #include "densityxx/context.hpp"
 #include "densityxx/block.hpp"
+#include "densityxx/adaptive.hpp"
+#include "densityxx/parallel.hpp"
+#include "densityxx/filter.hpp"
 
 namespace density {
     // buffer.
@@ -14,93 +19,797 @@ namespace density {
         result.bytes_written = context.get_total_written();
         return result;
     }
+    static DENSITY_INLINE processing_result_t
+    return_processing_result(state_t state, const uint_fast64_t bytes_read,
+                             const uint_fast64_t bytes_written)
+    {
+        processing_result_t result;
+        result.state = state;
+        result.bytes_read = bytes_read;
+        result.bytes_written = bytes_written;
+        return result;
+    }
 
 #define RETURN_RESULT(suffix) \
     return return_processing_result(context, state_##suffix)
 
     template<class KERNEL_ENCODE_T>static DENSITY_INLINE encode_state_t
-    do_compress(uint32_t *relative_position, context_t &context)
+    do_compress(uint32_t *relative_position, context_t &context,
+                block_encode_t<KERNEL_ENCODE_T> &block_encode)
     {
         encode_state_t encode_state;
-        block_encode_t<KERNEL_ENCODE_T> *block_encode = new block_encode_t<KERNEL_ENCODE_T>();
-        if ((encode_state = block_encode->init(context))) goto quit;
-        if ((encode_state = context.after(block_encode->continue_(context.before()))))
-            goto quit;
-        if ((encode_state = context.after(block_encode->finish(context.before())))) goto quit;
-        *relative_position = block_encode->read_bytes();
-    quit:
-        delete block_encode;
-        return encode_state;
+        if ((encode_state = block_encode.init(context))) return encode_state;
+        // The whole input is available, so stalling on input only means "call finish".
+        if ((encode_state = context.after(block_encode.continue_(context.before()))) &&
+            encode_state != encode_state_stall_on_input) return encode_state;
+        if ((encode_state = context.after(block_encode.finish(context.before()))))
+            return encode_state;
+        *relative_position = block_encode.read_bytes();
+        return encode_state_ready;
     }
-    processing_result_t
-    compress(const uint8_t *in, const uint_fast64_t szin,
-             uint8_t *out, const uint_fast64_t szout,
-             const compression_mode_t compression_mode,
-             const block_type_t block_type)
+    // Kernels selection, the dictionary kernels are only instantiated for even hash widths
+    // to keep the build time in check.
+    template<template<uint_fast8_t> class KERNEL_T, class ACTION_T>
+    static DENSITY_INLINE typename ACTION_T::result_t
+    dispatch_hash_bits(ACTION_T &action, const uint_fast8_t hash_bits)
     {
-        context_t context;
+        switch (hash_bits) {
+        case 10: return action.template run<KERNEL_T<10> >();
+        case 12: return action.template run<KERNEL_T<12> >();
+        case 14: return action.template run<KERNEL_T<14> >();
+        case 16: return action.template run<KERNEL_T<16> >();
+        default: return action.error();
+        }
+    }
+    // The encoders also take the stats policy.
+    template<template<uint_fast8_t, class> class KERNEL_T, class STATS_T, class ACTION_T>
+    static DENSITY_INLINE typename ACTION_T::result_t
+    dispatch_encode_hash_bits(ACTION_T &action, const uint_fast8_t hash_bits)
+    {
+        switch (hash_bits) {
+        case 10: return action.template run<KERNEL_T<10, STATS_T> >();
+        case 12: return action.template run<KERNEL_T<12, STATS_T> >();
+        case 14: return action.template run<KERNEL_T<14, STATS_T> >();
+        case 16: return action.template run<KERNEL_T<16, STATS_T> >();
+        default: return action.error();
+        }
+    }
+    template<class ACTION_T, class STATS_T = stats_off_t>
+    static DENSITY_INLINE typename ACTION_T::result_t
+    dispatch_encode(ACTION_T &action, const compression_mode_t compression_mode,
+                    const uint_fast8_t hash_bits)
+    {
+        switch (compression_mode) {
+        case compression_mode_copy:
+            return action.template run<copy_encode_t>();
+        case compression_mode_chameleon_algorithm:
+            return dispatch_encode_hash_bits<chameleon_encode_t, STATS_T>(action, hash_bits);
+        case compression_mode_cheetah_algorithm:
+            return dispatch_encode_hash_bits<cheetah_encode_t, STATS_T>(action, hash_bits);
+        case compression_mode_lion_algorithm:
+            return dispatch_encode_hash_bits<lion_encode_t, STATS_T>(action, hash_bits);
+        case compression_mode_adaptive:
+            // At the default width only, it holds all three kernels.
+            if (hash_bits != hash_default_bits) return action.error();
+            return action.template run<adaptive_encode_t<hash_default_bits, STATS_T> >();
+        default: return action.error();
+        }
+    }
+    template<class ACTION_T>static DENSITY_INLINE typename ACTION_T::result_t
+    dispatch_decode(ACTION_T &action, const compression_mode_t compression_mode,
+                    const uint_fast8_t hash_bits)
+    {
+        switch (compression_mode) {
+        case compression_mode_copy:
+            return action.template run<copy_decode_t>();
+        case compression_mode_chameleon_algorithm:
+            return dispatch_hash_bits<chameleon_decode_t>(action, hash_bits);
+        case compression_mode_cheetah_algorithm:
+            return dispatch_hash_bits<cheetah_decode_t>(action, hash_bits);
+        case compression_mode_lion_algorithm:
+            return dispatch_hash_bits<lion_decode_t>(action, hash_bits);
+        case compression_mode_adaptive:
+            if (hash_bits != hash_default_bits) return action.error();
+            return action.template run<adaptive_decode_t<hash_default_bits> >();
+        default: return action.error();
+        }
+    }
+
+    // The block encoder/decoder of the last kernel used is kept, it is only replaced when
+    // another kernel is asked for, the release function tells which one it is.
+    template<class BLOCK_T>static void release_block(void *block) { delete (BLOCK_T *)block; }
+    template<class BLOCK_T>static DENSITY_INLINE BLOCK_T &
+    reuse_block(void *&block, void (*&release)(void *))
+    {
+        if (release != release_block<BLOCK_T>) {
+            if (block) release(block);
+            block = new BLOCK_T();
+            release = release_block<BLOCK_T>;
+        }
+        return *(BLOCK_T *)block;
+    }
+
+    class encoder_action_t {
+    public:
+        typedef encode_state_t result_t;
+        context_t &context;
+        void *&block_encode;
+        void (*&release)(void *);
+        stats_t *stats;
         uint32_t relative_position;
 
+        DENSITY_INLINE encoder_action_t(context_t &context, void *&block_encode,
+                                        void (*&release)(void *), stats_t *stats):
+            context(context), block_encode(block_encode), release(release), stats(stats) {}
+        template<class KERNEL_ENCODE_T>DENSITY_INLINE encode_state_t run(void)
+        {   block_encode_t<KERNEL_ENCODE_T> &block =
+                reuse_block<block_encode_t<KERNEL_ENCODE_T> >(block_encode, release);
+            block.set_stats(stats);
+            return do_compress(&relative_position, context, block); }
+        DENSITY_INLINE encode_state_t error(void) { return encode_state_error; }
+    };
+    encoder_t::encoder_t(void):
+        context(new context_t()), block_encode(NULL), release(NULL), stats(NULL) {}
+    encoder_t::~encoder_t() { if (block_encode) release(block_encode); delete context; }
+    void
+    encoder_t::set_minimum_speed(const double minimum_speed)
+    {   context->minimum_speed = minimum_speed; }
+    void
+    encoder_t::set_stats(stats_t *stats) { this->stats = stats; }
+    void
+    encoder_t::set_filter(const filter_t filter, const uint_fast8_t element_size)
+    {   context->filter = filter;
+        context->filter_element_shift = element_size == 2 ? 1: element_size == 4 ? 2:
+            element_size == 8 ? 3: 0; }
+    processing_result_t
+    encoder_t::compress(const uint8_t *in, const uint_fast64_t szin,
+                        uint8_t *out, const uint_fast64_t szout,
+                        compression_mode_t compression_mode,
+                        const block_type_t block_type, const uint_fast8_t hash_bits)
+    {
+        context_t &context = *this->context;
+        encoder_action_t action(context, block_encode, release, stats);
+        // The kernels, and the sampling of compression_mode_auto, see the filtered input.
+        std::vector<uint8_t> filtered;
+        if (context.filter != filter_none) {
+            filtered.resize(szin);
+            if (!filter_encode(in, filtered.data(), szin, context.filter,
+                               context.filter_element_shift))
+                return return_processing_result(state_error_during_processing, 0, 0);
+            in = filtered.data();
+        }
+        if (compression_mode == compression_mode_auto)
+            compression_mode = select_compression_mode(in, szin, context.minimum_speed);
+
         context.init(compression_mode, block_type, in, szin, out, szout);
+        context.header.set_content_size(szin);
+        context.header.set_filter(context.filter, context.filter_element_shift);
+        if (hash_bits < hash_minimum_bits || hash_bits > hash_maximum_bits || (hash_bits & 1))
+            RETURN_RESULT(error_during_processing);
+        context.header.set_hash_bits(hash_bits);
         switch (context.write_header()) {
         case encode_state_ready: break;
         case encode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
         default: RETURN_RESULT(error_during_processing);
         }
+        // The counting kernels are only run when asked for.
+        const encode_state_t encode_state = stats ?
+            dispatch_encode<encoder_action_t, stats_on_t>(action, compression_mode, hash_bits):
+            dispatch_encode(action, compression_mode, hash_bits);
+        switch (encode_state) {
+        case encode_state_ready: break;
+        case encode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
+        default: RETURN_RESULT(error_during_processing);
+        }
+        switch (context.write_footer(action.relative_position)) {
+        case encode_state_ready: break;
+        case encode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
+        default: RETURN_RESULT(error_during_processing);
+        }
+        RETURN_RESULT(ok);
+    }
+    processing_result_t
+    compress(const uint8_t *in, const uint_fast64_t szin,
+             uint8_t *out, const uint_fast64_t szout,
+             const compression_mode_t compression_mode,
+             const block_type_t block_type, const uint_fast8_t hash_bits)
+    {
+        encoder_t encoder;
+        return encoder.compress(in, szin, out, szout, compression_mode, block_type, hash_bits);
+    }
+
+    // auto.
+    // The sample is made of auto_sample_pieces pieces spread over the input, a slower kernel
+    // is only picked when it saves more than 1/auto_sample_margin of the output of a faster
+    // one.
+    const uint_fast64_t auto_sample_piece_size = 1 << 14;
+    const uint_fast64_t auto_sample_pieces = 4;
+    const uint_fast64_t auto_sample_margin = 32;
+    compression_mode_t
+    select_compression_mode(const uint8_t *in, const uint_fast64_t szin,
+                            const double minimum_speed)
+    {
+        // From the fastest kernel to the strongest.
+        static const compression_mode_t modes[] = {
+            compression_mode_chameleon_algorithm, compression_mode_cheetah_algorithm,
+            compression_mode_lion_algorithm
+        };
+        if (!szin) return compression_mode_copy;
+        std::vector<uint8_t> sample;
+        if (szin <= auto_sample_piece_size * auto_sample_pieces) sample.assign(in, in + szin);
+        else for (uint_fast64_t piece = 0; piece < auto_sample_pieces; ++piece) {
+                const uint8_t *start = in + (szin - auto_sample_piece_size) * piece /
+                    (auto_sample_pieces - 1);
+                sample.insert(sample.end(), start, start + auto_sample_piece_size);
+            }
+        std::vector<uint8_t> out(compress_bound(sample.size(), compression_mode_auto,
+                                                block_type_default));
+        compression_mode_t best_mode = compression_mode_copy;
+        uint_fast64_t best_size = compress_bound(sample.size(), compression_mode_copy,
+                                                 block_type_default);
+        for (size_t idx = 0; idx < sizeof(modes) / sizeof(modes[0]); ++idx) {
+            encoder_t encoder;
+            processing_result_t result =
+                encoder.compress(sample.data(), sample.size(), out.data(), out.size(),
+                                 modes[idx], block_type_default);
+            if (result.state) continue;
+            if (minimum_speed > 0) {
+                // Timed on a second run, the first one has set the dictionary up.
+                const std::chrono::steady_clock::time_point start =
+                    std::chrono::steady_clock::now();
+                result = encoder.compress(sample.data(), sample.size(), out.data(), out.size(),
+                                          modes[idx], block_type_default);
+                const std::chrono::duration<double> elapsed =
+                    std::chrono::steady_clock::now() - start;
+                if (result.state || sample.size() < minimum_speed * 1e6 * elapsed.count())
+                    continue;
+            }
+            if (result.bytes_written + best_size / auto_sample_margin < best_size) {
+                best_mode = modes[idx];
+                best_size = result.bytes_written;
+            }
+        }
+        return best_mode;
+    }
+
+    // bound.
+    // Worst cases, every chunk is written plain: chameleon and cheetah add a signature per
+    // process unit, lion up to a 7 bits form code per chunk plus the end marker. The
+    // kernels also want some free output before they start a unit.
+    static DENSITY_INLINE uint_fast64_t
+    kernel_bound(const uint_fast64_t szin, const compression_mode_t compression_mode)
+    {
+        const uint_fast64_t chunks = szin / sizeof(uint32_t) + 1;
         switch (compression_mode) {
-        case compression_mode_copy:
-            switch (do_compress<copy_encode_t>(&relative_position, context)) {
-            case encode_state_ready: break;
-            case encode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
-            default: RETURN_RESULT(error_during_processing);
+        case compression_mode_copy: return szin;
+        case compression_mode_chameleon_algorithm:
+            return (szin / chameleon_encode_process_unit_size + 2) *
+                chameleon_maximum_compressed_unit_size;
+        case compression_mode_cheetah_algorithm:
+            return (szin / cheetah_encode_process_unit_size + 2) *
+                cheetah_maximum_compressed_unit_size;
+        case compression_mode_lion_algorithm:
+            return szin + (chunks * (lion_number_of_forms - 1) + 7) / 8 +
+                sizeof(lion_signature_t) + lion_encode_t<hash_default_bits>::minimum_lookahead;
+        case compression_mode_auto:
+            return std::max(std::max(kernel_bound(szin, compression_mode_chameleon_algorithm),
+                                     kernel_bound(szin, compression_mode_cheetah_algorithm)),
+                            kernel_bound(szin, compression_mode_lion_algorithm));
+        case compression_mode_adaptive:
+            // Plus the marker naming the kernel of each block, the blocks of a kernel
+            // resuming after a fall back to copy are shorter.
+            return kernel_bound(szin, compression_mode_auto) +
+                (szin / (preferred_copy_block_size >> 1) + 2) * sizeof(block_mode_marker_t);
+        default: return 0;
+        }
+    }
+    // Every block covers preferred_copy_block_size input bytes at most, whatever the kernel.
+    static DENSITY_INLINE uint_fast64_t
+    block_bound(const uint_fast64_t szin, const compression_mode_t compression_mode,
+                const block_type_t block_type)
+    {
+        uint_fast64_t block_overhead = sizeof(block_header_t) + sizeof(block_mode_marker_t);
+        if (block_type_integrity_checked(block_type))
+            block_overhead += sizeof(block_footer_t);
+        return kernel_bound(szin, compression_mode) +
+            (szin / preferred_copy_block_size + 1) * block_overhead;
+    }
+    uint_fast64_t
+    compress_bound(const uint_fast64_t szin, const compression_mode_t compression_mode,
+                   const block_type_t block_type)
+    {   return sizeof(main_header_t) + block_bound(szin, compression_mode, block_type) +
+            sizeof(main_footer_t); }
+
+    // parallel.
+    static DENSITY_INLINE uint_fast8_t
+    segment_automatic_shift(const uint_fast64_t szin, const unsigned threads)
+    {
+        uint_fast8_t segment_shift = segment_preferred_shift;
+        // Keep a few segments per worker, so that none of them idles at the end.
+        while (segment_shift > segment_automatic_minimum_shift &&
+               (szin >> segment_shift) < ((uint_fast64_t)threads << 2))
+            --segment_shift;
+        return segment_shift;
+    }
+
+    // Appends the compressed segments to the output in order, each one headed by a
+    // block_header_t pointing back to the previous segment header.
+    class segment_stitch_t {
+    public:
+        parallel_sequencer_t sequencer;
+        location_t out;
+        std::vector<uint_fast64_t> positions;
+        uint_fast64_t last_position, total_read;
+        std::atomic<bool> failed;
+        state_t state;
+
+        DENSITY_INLINE segment_stitch_t(uint8_t *out, const uint_fast64_t szout)
+        {   this->out.encapsulate(out, szout);
+            last_position = total_read = 0;
+            failed = false;
+            state = state_ok; }
+        DENSITY_INLINE void fail(const state_t state)
+        {   this->state = state; failed = true; }
+        DENSITY_INLINE void
+        append(const uint_fast64_t index, const encode_state_t encode_state,
+               const uint8_t *segment, const uint_fast64_t szsegment, const uint_fast64_t read)
+        {   block_header_t block_header;
+            const uint_fast64_t position = out.used();
+            if (encode_state) return fail(state_error_during_processing);
+            if (sizeof(block_header) + szsegment > out.available_bytes)
+                return fail(state_error_output_buffer_too_small);
+            block_header.write(&out, index ? (uint32_t)(position - last_position): 0);
+            out.write(segment, szsegment);
+            positions.push_back(position);
+            last_position = position;
+            total_read += read; }
+    };
+
+    template<class KERNEL_ENCODE_T>class segment_encode_t {
+    public:
+        const main_header_t *header;
+        const uint8_t *in;
+        uint_fast64_t szin;
+        uint_fast8_t segment_shift;
+        segment_stitch_t *stitch;
+
+        DENSITY_INLINE segment_encode_t(void): block_encode(NULL), scratch(NULL) {}
+        DENSITY_INLINE ~segment_encode_t() { delete block_encode; free(scratch); }
+        DENSITY_INLINE void operator()(const uint_fast64_t index)
+        {   const uint_fast64_t start = index << segment_shift;
+            const uint_fast64_t szsegment =
+                std::min(szin - start, (uint_fast64_t)1 << segment_shift);
+            const uint_fast64_t szscratch =
+                block_bound((uint_fast64_t)1 << segment_shift, header->compression_mode(),
+                            header->block_type());
+            encode_state_t encode_state = encode_state_error;
+            uint32_t relative_position;
+            if (!stitch->failed) {
+                if (!block_encode) block_encode = new block_encode_t<KERNEL_ENCODE_T>();
+                if (!scratch) scratch = (uint8_t *)malloc(szscratch);
+                // Without scratch encode_state stays an error, append fails the segment.
+                if (scratch) {
+                    context.init(header->compression_mode(), header->block_type(),
+                                 in + start, szsegment, scratch, szscratch);
+                    encode_state = do_compress(&relative_position, context, *block_encode);
+                }
             }
+            stitch->sequencer.wait(index);
+            if (!stitch->failed)
+                stitch->append(index, encode_state, scratch,
+                               context.get_total_written(), context.get_total_read());
+            stitch->sequencer.done(); }
+    private:
+        context_t context;
+        block_encode_t<KERNEL_ENCODE_T> *block_encode;
+        uint8_t *scratch;
+    };
+
+    template<class KERNEL_ENCODE_T>static DENSITY_INLINE void
+    do_compress_parallel(segment_stitch_t &stitch, const main_header_t &header,
+                         const uint8_t *in, const uint_fast64_t szin, unsigned threads)
+    {
+        const uint_fast8_t segment_shift = header.segment_shift();
+        const uint_fast64_t segments = szin ? ((szin - 1) >> segment_shift) + 1: 1;
+        if (threads > segments) threads = (unsigned)segments;
+        segment_encode_t<KERNEL_ENCODE_T> *workers =
+            new segment_encode_t<KERNEL_ENCODE_T>[threads];
+        for (unsigned idx = 0; idx < threads; ++idx) {
+            workers[idx].in = in;
+            workers[idx].szin = szin;
+            workers[idx].segment_shift = segment_shift;
+            workers[idx].header = &header;
+            workers[idx].stitch = &stitch;
+        }
+        parallel_run(workers, threads, segments);
+        delete[] workers;
+    }
+    static DENSITY_INLINE void
+    write_segment_index(segment_stitch_t &stitch, const uint_fast8_t segment_shift)
+    {
+        index_entry_t entry;
+        const uint_fast64_t entries = stitch.positions.size();
+        if ((entries + 1) * sizeof(entry) > stitch.out.available_bytes)
+            return stitch.fail(state_error_output_buffer_too_small);
+        const uint_fast64_t end = stitch.out.used();
+        for (uint_fast64_t index = 0; index < entries; ++index)
+            entry.write(&stitch.out, index << segment_shift, stitch.positions[index],
+                        index_entry_flag_reset);
+        entry.write(&stitch.out, stitch.total_read, end, 0);
+    }
+    processing_result_t
+    compress_parallel(const uint8_t *in, const uint_fast64_t szin,
+                      uint8_t *out, const uint_fast64_t szout,
+                      const compression_mode_t compression_mode,
+                      const block_type_t block_type,
+                      unsigned threads, uint_fast8_t segment_shift, const bool index)
+    {
+        if (compression_mode == compression_mode_auto)
+            return compress_parallel(in, szin, out, szout, select_compression_mode(in, szin),
+                                     block_type, threads, segment_shift, index);
+        segment_stitch_t stitch(out, szout);
+        main_header_t header;
+        main_footer_t footer;
+
+        threads = parallel_threads(threads);
+        if (!segment_shift) segment_shift = segment_automatic_shift(szin, threads);
+        else if (segment_shift < segment_minimum_shift || segment_shift > segment_maximum_shift)
+            return return_processing_result(state_error_during_processing, 0, 0);
+        header.setup(compression_mode, block_type);
+        header.set_segment_shift(segment_shift);
+        header.set_content_size(szin);
+        if (index) header.set_flag(main_header_flag_index);
+        if (sizeof(header) > stitch.out.available_bytes)
+            return return_processing_result(state_error_output_buffer_too_small, 0, 0);
+        stitch.out.write(&header, sizeof(header));
+        switch (compression_mode) {
+        case compression_mode_copy:
+            do_compress_parallel<copy_encode_t>(stitch, header, in, szin, threads);
             break;
         case compression_mode_chameleon_algorithm:
-            switch (do_compress<chameleon_encode_t>(&relative_position, context)) {
-            case encode_state_ready: break;
-            case encode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
-            default: RETURN_RESULT(error_during_processing);
-            }
+            do_compress_parallel<chameleon_encode_t<hash_default_bits> >(stitch, header,
+                                                       in, szin, threads);
             break;
         case compression_mode_cheetah_algorithm:
-            switch (do_compress<cheetah_encode_t>(&relative_position, context)) {
-            case encode_state_ready: break;
-            case encode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
-            default: RETURN_RESULT(error_during_processing);
-            }
+            do_compress_parallel<cheetah_encode_t<hash_default_bits> >(stitch, header,
+                                                     in, szin, threads);
             break;
         case compression_mode_lion_algorithm:
-            switch (do_compress<lion_encode_t>(&relative_position, context)) {
-            case encode_state_ready: break;
-            case encode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
-            default: RETURN_RESULT(error_during_processing);
-            }
+            do_compress_parallel<lion_encode_t<hash_default_bits> >(stitch, header,
+                                                  in, szin, threads);
             break;
+        case compression_mode_adaptive:
+            do_compress_parallel<adaptive_encode_t<hash_default_bits> >(stitch, header,
+                                                      in, szin, threads);
+            break;
+        default: stitch.fail(state_error_during_processing); break;
         }
-        switch (context.write_footer(relative_position)) {
-        case encode_state_ready: break;
-        case encode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
-        default: RETURN_RESULT(error_during_processing);
-        }
-        RETURN_RESULT(ok);
+        if (stitch.state == state_ok && index) write_segment_index(stitch, segment_shift);
+        if (stitch.state == state_ok && sizeof(footer) > stitch.out.available_bytes)
+            stitch.fail(state_error_output_buffer_too_small);
+        if (stitch.state == state_ok)
+            footer.write(&stitch.out, (uint32_t)(stitch.out.used() - stitch.last_position));
+        return return_processing_result(stitch.state, stitch.total_read, stitch.out.used());
+    }
+    // Every segment is a block header followed by the blocks of its own bound, more segments
+    // only add overhead.
+    uint_fast64_t
+    compress_parallel_bound(const uint_fast64_t szin, const compression_mode_t compression_mode,
+                            const block_type_t block_type, uint_fast8_t segment_shift,
+                            const bool index)
+    {
+        if (!segment_shift) segment_shift = segment_automatic_minimum_shift;
+        else if (segment_shift < segment_minimum_shift || segment_shift > segment_maximum_shift)
+            return 0;
+        const uint_fast64_t szsegment = (uint_fast64_t)1 << segment_shift;
+        const uint_fast64_t full = szin >> segment_shift, rest = szin & (szsegment - 1);
+        const uint_fast64_t segments = full + (rest || !full ? 1: 0);
+        uint_fast64_t bound = sizeof(main_header_t) + segments * sizeof(block_header_t) +
+            full * block_bound(szsegment, compression_mode, block_type) +
+            (rest || !full ? block_bound(rest, compression_mode, block_type): 0) +
+            sizeof(main_footer_t);
+        if (index) bound += (segments + 1) * sizeof(index_entry_t);
+        return bound;
     }
 
     template<class KERNEL_DECODE_T>static DENSITY_INLINE decode_state_t
-    do_decompress(context_t &context)
+    do_decompress_step(context_t &context, block_decode_t<KERNEL_DECODE_T> &block_decode,
+                       bool &finishing)
     {
         decode_state_t decode_state;
-        block_decode_t<KERNEL_DECODE_T> *block_decode = new block_decode_t<KERNEL_DECODE_T>();
-        if ((decode_state = block_decode->init(context))) goto quit;
-        if ((decode_state = context.after(block_decode->continue_(context.before()))))
-            goto quit;
-        if ((decode_state = context.after(block_decode->finish(context.before())))) goto quit;
-    quit:
-        delete block_decode;
+        if (!finishing) {
+            decode_state = context.after(block_decode.continue_(context.before()));
+            if (decode_state != decode_state_stall_on_input) return decode_state;
+            finishing = true;
+        }
+        return context.after(block_decode.finish(context.before()));
+    }
+    // The kernels stall with less than decode_output_lookahead bytes of output left, the
+    // end of the output is then decoded to a side buffer and copied back, so an output
+    // buffer of the exact decompressed size is enough.
+    template<class KERNEL_DECODE_T>static DENSITY_INLINE decode_state_t
+    do_decompress(context_t &context, block_decode_t<KERNEL_DECODE_T> &block_decode)
+    {
+        uint8_t tail[decode_output_lookahead << 1];
+        decode_state_t decode_state;
+        bool finishing = false;
+        if ((decode_state = block_decode.init(context))) return decode_state;
+        decode_state = do_decompress_step(context, block_decode, finishing);
+        while (decode_state == decode_state_stall_on_output) {
+            uint8_t *const pointer = context.out.pointer;
+            const uint_fast64_t available = context.out.available_bytes;
+            context.update_output(tail, sizeof(tail));
+            decode_state = do_decompress_step(context, block_decode, finishing);
+            const uint_fast64_t used = context.out.used();
+            if (used > available || (!used && decode_state == decode_state_stall_on_output))
+                return decode_state_stall_on_output;
+            DENSITY_MEMCPY(pointer, tail, used);
+            context.update_output(pointer + used, available - used);
+        }
         return decode_state;
     }
+    // Walks the chain of segment headers backwards from the main footer, positions get
+    // the offset of every segment header followed by the offset where the data ends.
+    static DENSITY_INLINE bool
+    read_segment_positions(std::vector<uint_fast64_t> &positions,
+                           const uint8_t *in, const uint_fast64_t szin, const uint_fast64_t end)
+    {
+        location_t location;
+        main_footer_t footer;
+        block_header_t block_header;
+        if (szin < sizeof(main_header_t) + sizeof(block_header) + sizeof(footer)) return false;
+        uint_fast64_t position = szin - sizeof(footer), relative_position;
+        location.encapsulate((uint8_t *)in + position, sizeof(footer));
+        footer.read(&location);
+        positions.push_back(end);
+        relative_position = footer.relative_position;
+        do {
+            if (relative_position < sizeof(block_header) ||
+                relative_position > position - sizeof(main_header_t)) return false;
+            position -= relative_position;
+            positions.push_back(position);
+            location.encapsulate((uint8_t *)in + position, sizeof(block_header));
+            block_header.read(&location);
+        } while ((relative_position = block_header.relative_position));
+        if (position != sizeof(main_header_t) || positions[1] >= end) return false;
+        std::reverse(positions.begin(), positions.end());
+        return true;
+    }
+    // Same as above from the seek index, without touching the compressed data.
+    static DENSITY_INLINE bool
+    read_index_positions(std::vector<uint_fast64_t> &positions, const main_header_t &header,
+                         const uint8_t *in, const uint_fast64_t szin)
+    {
+        location_t location;
+        index_entry_t entry;
+        if (szin < sizeof(main_header_t) + sizeof(entry) + sizeof(main_footer_t)) return false;
+        const uint_fast64_t last = szin - sizeof(main_footer_t) - sizeof(entry);
+        location.encapsulate((uint8_t *)in + last, sizeof(entry));
+        entry.read(&location);
+        const uint_fast64_t end = entry.compressed_offset;
+        if (end <= sizeof(main_header_t) || end > last || (last - end) % sizeof(entry))
+            return false;
+        location.encapsulate((uint8_t *)in + end, last - end + sizeof(entry));
+        for (uint_fast64_t index = 0; index <= (last - end) / sizeof(entry); ++index) {
+            entry.read(&location);
+            if (entry.compressed_offset < (index ? positions.back() + sizeof(block_header_t):
+                                           sizeof(main_header_t)) ||
+                entry.compressed_offset > end ||
+                (entry.compressed_offset < end &&
+                 entry.original_offset != index << header.segment_shift()))
+                return false;
+            positions.push_back(entry.compressed_offset);
+        }
+        return positions.size() > 1 && positions[0] == sizeof(main_header_t);
+    }
+    static DENSITY_INLINE bool
+    read_positions(std::vector<uint_fast64_t> &positions, const main_header_t &header,
+                   const uint8_t *in, const uint_fast64_t szin)
+    {
+        if (header.has_flag(main_header_flag_index))
+            return read_index_positions(positions, header, in, szin);
+        return szin >= sizeof(main_footer_t) &&
+            read_segment_positions(positions, in, szin, szin - sizeof(main_footer_t));
+    }
+    template<class KERNEL_DECODE_T>static DENSITY_INLINE state_t
+    decompress_segment(context_t &context, block_decode_t<KERNEL_DECODE_T> &block_decode,
+                       const main_header_t &header, const uint8_t *in,
+                       const std::vector<uint_fast64_t> &positions, const uint_fast64_t index,
+                       uint8_t *out, const uint_fast64_t szout)
+    {
+        const uint_fast64_t szsegment = (uint_fast64_t)1 << header.segment_shift();
+        const uint_fast64_t position = positions[index] + sizeof(block_header_t);
+        const bool last = index + 2 == positions.size();
+        // What follows the segment is reserved by the block decoder as a main footer.
+        // The kernels want a whole unit of free output before decoding one, so the output
+        // is not cut at the segment end, the decoded size is checked afterwards instead.
+        context.init(header.compression_mode(), header.block_type(), in + position,
+                     positions[index + 1] - position + context_t::end_data_overhead,
+                     out, szout);
+        context.header = header;
+        switch (do_decompress(context, block_decode)) {
+        case decode_state_ready: break;
+        case decode_state_stall_on_output: return state_error_output_buffer_too_small;
+        default: return state_error_during_processing;
+        }
+        if (!last && context.get_total_written() != szsegment)
+            return state_error_during_processing;
+        return state_ok;
+    }
+    // Decodes the segments handed out by parallel_run, they are independent of each other
+    // so nothing has to be ordered, the first failing segment is remembered.
+    template<class KERNEL_DECODE_T>class segment_decode_t {
+    public:
+        const main_header_t *header;
+        const uint8_t *in;
+        const std::vector<uint_fast64_t> *positions;
+        uint8_t *out;
+        uint_fast64_t szout;
+        std::atomic<uint_fast64_t> *failed_index;
+        std::atomic<uint_fast64_t> *last_written;
+        state_t *failed_state;
+        std::mutex *failed_mutex;
+
+        DENSITY_INLINE segment_decode_t(void): block_decode(NULL) {}
+        DENSITY_INLINE ~segment_decode_t() { delete block_decode; }
+        DENSITY_INLINE void operator()(const uint_fast64_t index)
+        {   const uint_fast64_t start = index << header->segment_shift();
+            state_t state = state_error_output_buffer_too_small;
+            if (index > *failed_index) return;
+            if (!block_decode) block_decode = new block_decode_t<KERNEL_DECODE_T>();
+            if (start > szout ||
+                (state = decompress_segment(context, *block_decode, *header, in, *positions,
+                                            index, out + start, szout - start))) {
+                std::lock_guard<std::mutex> lock(*failed_mutex);
+                if (index < *failed_index) { *failed_index = index; *failed_state = state; }
+            } else if (index + 2 == positions->size())
+                *last_written = context.get_total_written(); }
+    private:
+        context_t context;
+        block_decode_t<KERNEL_DECODE_T> *block_decode;
+    };
+    template<class KERNEL_DECODE_T>static DENSITY_INLINE processing_result_t
+    do_decompress_segments(const main_header_t &header, const uint8_t *in,
+                           const std::vector<uint_fast64_t> &positions,
+                           uint8_t *out, const uint_fast64_t szout, unsigned threads)
+    {
+        const uint_fast64_t segments = positions.size() - 1;
+        std::atomic<uint_fast64_t> failed_index(segments), last_written(0);
+        state_t failed_state = state_ok;
+        std::mutex failed_mutex;
+        if (threads > segments) threads = (unsigned)segments;
+        segment_decode_t<KERNEL_DECODE_T> *workers =
+            new segment_decode_t<KERNEL_DECODE_T>[threads];
+        for (unsigned idx = 0; idx < threads; ++idx) {
+            workers[idx].header = &header;
+            workers[idx].in = in;
+            workers[idx].positions = &positions;
+            workers[idx].out = out;
+            workers[idx].szout = szout;
+            workers[idx].failed_index = &failed_index;
+            workers[idx].last_written = &last_written;
+            workers[idx].failed_state = &failed_state;
+            workers[idx].failed_mutex = &failed_mutex;
+        }
+        parallel_run(workers, threads, segments);
+        delete[] workers;
+        if (failed_state)
+            return return_processing_result(failed_state, positions[failed_index],
+                                            failed_index << header.segment_shift());
+        return return_processing_result(state_ok, 0, ((segments - 1) << header.segment_shift()) +
+                                        last_written);
+    }
+    static DENSITY_INLINE processing_result_t
+    decompress_segments(const main_header_t &header, const uint8_t *in, const uint_fast64_t szin,
+                        uint8_t *out, const uint_fast64_t szout, const unsigned threads)
+    {
+        std::vector<uint_fast64_t> positions;
+        processing_result_t result;
+        // Segmented streams are always compressed with the default hash width, unfiltered.
+        if (header.hash_bits() != hash_default_bits || header.filter() != filter_none ||
+            !read_positions(positions, header, in, szin))
+            return return_processing_result(state_error_during_processing, 0, 0);
+        switch (header.compression_mode()) {
+        case compression_mode_copy:
+            result = do_decompress_segments<copy_decode_t>(header, in, positions,
+                                                           out, szout, threads);
+            break;
+        case compression_mode_chameleon_algorithm:
+            result = do_decompress_segments<chameleon_decode_t<hash_default_bits> >
+                (header, in, positions, out, szout, threads);
+            break;
+        case compression_mode_cheetah_algorithm:
+            result = do_decompress_segments<cheetah_decode_t<hash_default_bits> >
+                (header, in, positions, out, szout, threads);
+            break;
+        case compression_mode_lion_algorithm:
+            result = do_decompress_segments<lion_decode_t<hash_default_bits> >
+                (header, in, positions, out, szout, threads);
+            break;
+        case compression_mode_adaptive:
+            result = do_decompress_segments<adaptive_decode_t<hash_default_bits> >
+                (header, in, positions, out, szout, threads);
+            break;
+        default: return return_processing_result(state_error_during_processing, 0, 0);
+        }
+        // The main footer closes the input of a segmented stream.
+        if (result.state == state_ok) result.bytes_read = szin;
+        return result;
+    }
+    class decoder_action_t {
+    public:
+        typedef decode_state_t result_t;
+        context_t &context;
+        void *&block_decode;
+        void (*&release)(void *);
+
+        DENSITY_INLINE decoder_action_t(context_t &context, void *&block_decode,
+                                        void (*&release)(void *)):
+            context(context), block_decode(block_decode), release(release) {}
+        template<class KERNEL_DECODE_T>DENSITY_INLINE decode_state_t run(void)
+        {   return do_decompress(context,
+                                 reuse_block<block_decode_t<KERNEL_DECODE_T> >(block_decode,
+                                                                               release)); }
+        DENSITY_INLINE decode_state_t error(void) { return decode_state_error; }
+    };
+    decoder_t::decoder_t(void): context(new context_t()), block_decode(NULL), release(NULL) {}
+    decoder_t::~decoder_t() { if (block_decode) release(block_decode); delete context; }
+    processing_result_t
+    decoder_t::decompress(const uint8_t *in, const uint_fast64_t szin,
+                          uint8_t *out, const uint_fast64_t szout)
+    {
+        context_t &context = *this->context;
+        decoder_action_t action(context, block_decode, release);
+
+        context.init(compression_mode_copy, block_type_default, in, szin, out, szout);
+        switch (context.read_header()) {
+        case decode_state_ready: break;
+        case decode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
+        default: RETURN_RESULT(error_during_processing);
+        }
+        if (context.header.has_flag(main_header_flag_content_size) &&
+            context.header.content_size() > szout)
+            RETURN_RESULT(error_output_buffer_too_small);
+        if (context.header.segment_shift())
+            return decompress_segments(context.header, in, szin, out, szout, 1);
+        switch (dispatch_decode(action, context.header.compression_mode(),
+                                context.header.hash_bits())) {
+        case decode_state_ready: break;
+        case decode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
+        default: RETURN_RESULT(error_during_processing);
+        }
+        switch (context.read_footer()) {
+        case decode_state_ready: break;
+        case decode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
+        default: RETURN_RESULT(error_during_processing);
+        }
+        if (context.header.filter() != filter_none &&
+            !filter_decode(out, context.get_total_written(), context.header.filter(),
+                           context.header.filter_element_shift()))
+            RETURN_RESULT(error_during_processing);
+        RETURN_RESULT(ok);
+    }
     processing_result_t
     decompress(const uint8_t *in, const uint_fast64_t szin,
                uint8_t *out, const uint_fast64_t szout)
+    {
+        decoder_t decoder;
+        return decoder.decompress(in, szin, out, szout);
+    }
+
+    uint_fast64_t
+    get_decompressed_size(const uint8_t *in, const uint_fast64_t szin)
+    {
+        main_header_t header;
+        if (szin < sizeof(header)) return content_size_unknown;
+        DENSITY_MEMCPY(&header, in, sizeof(header));
+        if (!header.has_flag(main_header_flag_content_size)) return content_size_unknown;
+        return header.content_size();
+    }
+
+    processing_result_t
+    decompress_parallel(const uint8_t *in, const uint_fast64_t szin,
+                        uint8_t *out, const uint_fast64_t szout, const unsigned threads)
     {
         context_t context;
 
@@ -110,41 +819,166 @@ namespace density {
         case decode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
         default: RETURN_RESULT(error_during_processing);
         }
+        if (context.header.has_flag(main_header_flag_content_size) &&
+            context.header.content_size() > szout)
+            RETURN_RESULT(error_output_buffer_too_small);
+        // A plain stream is a single dependency chain, there is nothing to split.
+        if (!context.header.segment_shift()) return decompress(in, szin, out, szout);
+        return decompress_segments(context.header, in, szin, out, szout,
+                                   parallel_threads(threads));
+    }
+
+    // Decodes the segments overlapping [offset, offset + length) and keeps that part only,
+    // the segments lying entirely inside the range are decoded in place.
+    template<class KERNEL_DECODE_T>static DENSITY_INLINE processing_result_t
+    do_decompress_range(const main_header_t &header, const uint8_t *in,
+                        const std::vector<uint_fast64_t> &positions, uint8_t *out,
+                        const uint_fast64_t offset, const uint_fast64_t length)
+    {
+        const uint_fast8_t segment_shift = header.segment_shift();
+        const uint_fast64_t szsegment = (uint_fast64_t)1 << segment_shift;
+        const uint_fast64_t szscratch = szsegment + decode_output_lookahead;
+        context_t context;
+        block_decode_t<KERNEL_DECODE_T> *block_decode = new block_decode_t<KERNEL_DECODE_T>();
+        uint8_t *scratch = NULL;
+        state_t state = state_ok;
+        uint_fast64_t index, skip, decoded, written = 0;
+        for (index = offset >> segment_shift;
+             written < length && index + 1 < positions.size(); ++index) {
+            skip = offset + written - (index << segment_shift);
+            if (!skip && length - written >= szscratch) {
+                if ((state = decompress_segment(context, *block_decode, header, in, positions,
+                                                index, out + written, length - written)))
+                    break;
+                written += (decoded = context.get_total_written());
+            } else {
+                if (!scratch && !(scratch = (uint8_t *)malloc(szscratch))) {
+                    state = state_error_during_processing;
+                    break;
+                }
+                if ((state = decompress_segment(context, *block_decode, header, in, positions,
+                                                index, scratch, szscratch)))
+                    break;
+                if ((decoded = context.get_total_written()) <= skip) break;
+                const uint_fast64_t copied = std::min(decoded - skip, length - written);
+                DENSITY_MEMCPY(out + written, scratch + skip, copied);
+                written += copied;
+            }
+            if (decoded < szsegment) break;
+        }
+        free(scratch);
+        delete block_decode;
+        index = std::min(index, (uint_fast64_t)positions.size() - 1);
+        return return_processing_result(state, positions[index], written);
+    }
+    processing_result_t
+    decompress_range(const uint8_t *in, const uint_fast64_t szin,
+                     uint8_t *out, const uint_fast64_t szout,
+                     const uint_fast64_t offset, const uint_fast64_t length)
+    {
+        context_t context;
+        std::vector<uint_fast64_t> positions;
+
+        if (length > szout)
+            return return_processing_result(state_error_output_buffer_too_small, 0, 0);
+        context.init(compression_mode_copy, block_type_default, in, szin, out, szout);
+        switch (context.read_header()) {
+        case decode_state_ready: break;
+        case decode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
+        default: RETURN_RESULT(error_during_processing);
+        }
+        // Plain streams have no reset point to start from but their beginning.
+        if (!context.header.segment_shift() ||
+            context.header.hash_bits() != hash_default_bits ||
+            context.header.filter() != filter_none ||
+            !read_positions(positions, context.header, in, szin))
+            RETURN_RESULT(error_during_processing);
         switch (context.header.compression_mode()) {
         case compression_mode_copy:
-            switch (do_decompress<copy_decode_t>(context)) {
-            case decode_state_ready: break;
-            case decode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
-            default: RETURN_RESULT(error_during_processing);
-            }
-            break;
+            return do_decompress_range<copy_decode_t>(context.header, in, positions,
+                                                      out, offset, length);
         case compression_mode_chameleon_algorithm:
-            switch (do_decompress<chameleon_decode_t>(context)) {
-            case decode_state_ready: break;
-            case decode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
-            default: RETURN_RESULT(error_during_processing);
-            }
-            break;
+            return do_decompress_range<chameleon_decode_t<hash_default_bits> >
+                (context.header, in, positions, out, offset, length);
         case compression_mode_cheetah_algorithm:
-            switch (do_decompress<cheetah_decode_t>(context)) {
-            case decode_state_ready: break;
-            case decode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
-            default: RETURN_RESULT(error_during_processing);
-            }
-            break;
+            return do_decompress_range<cheetah_decode_t<hash_default_bits> >
+                (context.header, in, positions, out, offset, length);
         case compression_mode_lion_algorithm:
-            switch (do_decompress<lion_decode_t>(context)) {
-            case decode_state_ready: break;
-            case decode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
-            default: RETURN_RESULT(error_during_processing);
-            }
-            break;
-        }
-        switch (context.read_footer()) {
-        case decode_state_ready: break;
-        case decode_state_stall_on_output: RETURN_RESULT(error_output_buffer_too_small);
+            return do_decompress_range<lion_decode_t<hash_default_bits> >
+                (context.header, in, positions, out, offset, length);
+        case compression_mode_adaptive:
+            return do_decompress_range<adaptive_decode_t<hash_default_bits> >
+                (context.header, in, positions, out, offset, length);
         default: RETURN_RESULT(error_during_processing);
         }
-        RETURN_RESULT(ok);
+    }
+
+    // batch.
+    class batch_encode_t {
+    public:
+        batch_message_t *messages;
+        compression_mode_t compression_mode;
+        block_type_t block_type;
+        uint_fast8_t hash_bits;
+
+        DENSITY_INLINE void operator()(const uint_fast64_t index)
+        {   batch_message_t &message = messages[index];
+            message.result = encoder.compress(message.in, message.szin,
+                                              message.out, message.szout,
+                                              compression_mode, block_type, hash_bits); }
+    private:
+        encoder_t encoder;
+    };
+    class batch_decode_t {
+    public:
+        batch_message_t *messages;
+
+        DENSITY_INLINE void operator()(const uint_fast64_t index)
+        {   batch_message_t &message = messages[index];
+            message.result = decoder.decompress(message.in, message.szin,
+                                                message.out, message.szout); }
+    private:
+        decoder_t decoder;
+    };
+    static DENSITY_INLINE state_t
+    batch_state(const batch_message_t *messages, const uint_fast64_t count)
+    {
+        for (uint_fast64_t index = 0; index < count; ++index)
+            if (messages[index].result.state) return messages[index].result.state;
+        return state_ok;
+    }
+    static DENSITY_INLINE unsigned
+    batch_threads(const unsigned threads, const uint_fast64_t count)
+    {   const unsigned batch_threads = parallel_threads(threads);
+        return count < batch_threads ? (unsigned)std::max(count, (uint_fast64_t)1):
+            batch_threads; }
+
+    state_t
+    compress_batch(batch_message_t *messages, const uint_fast64_t count,
+                   const compression_mode_t compression_mode,
+                   const block_type_t block_type,
+                   unsigned threads, const uint_fast8_t hash_bits)
+    {
+        threads = batch_threads(threads, count);
+        batch_encode_t *workers = new batch_encode_t[threads];
+        for (unsigned idx = 0; idx < threads; ++idx) {
+            workers[idx].messages = messages;
+            workers[idx].compression_mode = compression_mode;
+            workers[idx].block_type = block_type;
+            workers[idx].hash_bits = hash_bits;
+        }
+        parallel_run(workers, threads, count);
+        delete[] workers;
+        return batch_state(messages, count);
+    }
+    state_t
+    decompress_batch(batch_message_t *messages, const uint_fast64_t count, unsigned threads)
+    {
+        threads = batch_threads(threads, count);
+        batch_decode_t *workers = new batch_decode_t[threads];
+        for (unsigned idx = 0; idx < threads; ++idx) workers[idx].messages = messages;
+        parallel_run(workers, threads, count);
+        delete[] workers;
+        return batch_state(messages, count);
     }
 }
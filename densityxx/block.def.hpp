@@ -2,14 +2,34 @@
 #pragma once
 #include "densityxx/kernel.hpp"
 #include "densityxx/spookyhash.hpp"
+#include "densityxx/crc32c.hpp"
 #include "densityxx/context.hpp"
+#include "densityxx/parallel.hpp"
 
 namespace density {
+    // integrity hash.
+#pragma pack(push)
+#pragma pack(4)
+    // Hashsum of the block footers, by the algorithm the block type names.
+    class integrity_hash_t {
+    public:
+        void init(const block_type_t block_type);
+        void update(const void *message, size_t length);
+        void final(uint64_t *hash1, uint64_t *hash2);
+    private:
+        block_type_t block_type;
+        spookyhash_context_t spooky;
+        crc32c_context_t crc32c;
+    };
+#pragma pack(pop)
+
     // encode.
 #pragma pack(push)
 #pragma pack(4)
     class block_encode_base_t {
     public:
+        DENSITY_INLINE block_encode_base_t(void): helper(NULL) {}
+        DENSITY_INLINE ~block_encode_base_t() { delete helper; }
         DENSITY_INLINE const compression_mode_t mode(void) const { return target_mode; }
         DENSITY_INLINE const block_type_t get_block_type(void) const { return block_type; }
         DENSITY_INLINE uint32_t read_bytes(void) const
@@ -36,14 +56,19 @@ namespace density {
         // integrity_data.
         bool update;
         uint8_t *input_pointer;
-        spookyhash_context_t spooky;
+        integrity_hash_t integrity_hash;
+        // Hashes in the background when set, the input hashed must stay in place until
+        // the next exit.
+        parallel_helper_t *helper;
 
         DENSITY_INLINE encode_state_t exit_process(process_t process, encode_state_t state)
-        {   this->process = process; return state; }
-
+        {   this->process = process; if (helper) helper->wait(); return state; }
 
         DENSITY_INLINE void update_integrity_data(teleport_t *in)
         {   input_pointer = in->direct.pointer; update = false; }
+        DENSITY_INLINE void update_integrity_hash(const uint8_t *pointer, const uint_fast64_t bytes)
+        {   if (!helper) integrity_hash.update(pointer, bytes);
+            else helper->post([this, pointer, bytes]() { integrity_hash.update(pointer, bytes); }); }
 
         void update_integrity_hash(teleport_t *in, bool pending_exit);
 
@@ -65,8 +90,14 @@ namespace density {
         encode_state_t init(context_t &context);
         encode_state_t continue_(context_t &context);
         encode_state_t finish(context_t &context);
+        // Counted in by the kernel policy, nothing is counted without one.
+        DENSITY_INLINE void set_stats(stats_t *counters) { kernel_encode.set_stats(counters); }
     private:
         KERNEL_ENCODE_T kernel_encode;
+
+        DENSITY_INLINE void count_block(void)
+        {   kernel_encode.stats.block(current_mode, current_mode != target_mode,
+                                      total_read - in_start, total_written - out_start); }
     };
 #pragma pack(pop)
 
@@ -75,6 +106,8 @@ namespace density {
 #pragma pack(4)
     class block_decode_base_t {
     public:
+        DENSITY_INLINE block_decode_base_t(void): helper(NULL) {}
+        DENSITY_INLINE ~block_decode_base_t() { delete helper; }
         DENSITY_INLINE const compression_mode_t mode(void) const { return target_mode; }
         DENSITY_INLINE const block_type_t get_block_type(void) const { return block_type; }
     protected:
@@ -107,13 +140,26 @@ namespace density {
         // integrity_data.
         bool update;
         uint8_t *output_pointer;
-        spookyhash_context_t spooky;
+        integrity_hash_t integrity_hash;
+        // Hashes in the background when set, the footers are checked there and a failure is
+        // reported at the next exit.
+        parallel_helper_t *helper;
+        bool integrity_failed;
 
         DENSITY_INLINE decode_state_t exit_process(process_t process, decode_state_t state)
-        {   this->process = process; return state; }
+        {   this->process = process;
+            if (helper) {
+                helper->wait();
+                if (integrity_failed && state != decode_state_error)
+                    return decode_state_integrity_check_fail;
+            }
+            return state; }
 
         DENSITY_INLINE void update_integrity_data(location_t *out)
         {   output_pointer = out->pointer; update = false; }
+        DENSITY_INLINE void update_integrity_hash(const uint8_t *pointer, const uint_fast64_t bytes)
+        {   if (!helper) integrity_hash.update(pointer, bytes);
+            else helper->post([this, pointer, bytes]() { integrity_hash.update(pointer, bytes); }); }
 
         void update_integrity_hash(location_t *out, bool pending_exit);
         decode_state_t read_block_header(teleport_t *in, location_t *out);
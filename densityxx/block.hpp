@@ -6,6 +6,29 @@ namespace density {
     const uint64_t preferred_copy_block_size = 1 << 19;
     const uint64_t spookyhash_seed_1 = 0xabc;
     const uint64_t spookyhash_seed_2 = 0xdef;
+
+    // integrity hash.
+    DENSITY_INLINE void
+    integrity_hash_t::init(const block_type_t block_type)
+    {
+        this->block_type = block_type;
+        if (block_type == block_type_with_crc32c_integrity_check) crc32c.init();
+        else spooky.init(spookyhash_seed_1, spookyhash_seed_2);
+    }
+    DENSITY_INLINE void
+    integrity_hash_t::update(const void *message, size_t length)
+    {
+        if (block_type == block_type_with_crc32c_integrity_check)
+            crc32c.update(message, length);
+        else spooky.update(message, length);
+    }
+    DENSITY_INLINE void
+    integrity_hash_t::final(uint64_t *hash1, uint64_t *hash2)
+    {
+        if (block_type == block_type_with_crc32c_integrity_check) crc32c.final(hash1, hash2);
+        else spooky.final(hash1, hash2);
+    }
+
     // encode.
     template<class KERNEL_ENCODE_T> DENSITY_INLINE encode_state_t
     block_encode_t<KERNEL_ENCODE_T>::init(context_t &context)
@@ -13,7 +36,12 @@ namespace density {
         current_mode = target_mode = kernel_encode.mode();
         block_type = context.header.block_type();
         total_read = total_written = 0;
-        if (block_type == block_type_with_hashsum_integrity_check) update = true;
+        if (block_type_integrity_checked(block_type)) update = true;
+        if (!block_type_integrity_checked(block_type) || !context.integrity_helper) {
+            delete helper;
+            helper = NULL;
+        } else if (!helper) helper = new parallel_helper_t();
+        kernel_encode.set_minimum_speed(context.minimum_speed);
         kernel_encode.init();
         return exit_process(process_write_block_header, encode_state_ready);
     }
@@ -26,7 +54,7 @@ namespace density {
         kernel_encode_t::state_t kernel_encode_state;
         uint_fast64_t available_in_before, available_out_before;
         // Add to the integrity check hashsum
-        if (block_type == block_type_with_hashsum_integrity_check && update)
+        if (block_type_integrity_checked(block_type) && update)
             update_integrity_data(in);
         // Dispatch
         switch (process) {
@@ -56,7 +84,7 @@ namespace density {
                 else {
                     in->copy(out, in_remaining);
                     update_totals(in, out, available_in_before, available_out_before);
-                    if (block_type == block_type_with_hashsum_integrity_check)
+                    if (block_type_integrity_checked(block_type))
                         update_integrity_hash(in, true);
                     in->copy_from_direct_buffer_to_staging_buffer();
                     return exit_process(process_write_data, encode_state_stall_on_input);
@@ -78,20 +106,21 @@ namespace density {
             update_totals(in, out, available_in_before, available_out_before);
             switch (kernel_encode_state) {
             case kernel_encode_t::state_stall_on_input:
-                if (block_type == block_type_with_hashsum_integrity_check)
+                if (block_type_integrity_checked(block_type))
                     update_integrity_hash(in, true);
                 return exit_process(process_write_data, encode_state_stall_on_input);
             case kernel_encode_t::state_stall_on_output:
                 return exit_process(process_write_data, encode_state_stall_on_output);
             case kernel_encode_t::state_info_new_block: goto write_block_footer;
             case kernel_encode_t::state_info_efficiency_check: goto write_mode_marker;
-            default: return encode_state_error;
+            default: return exit_process(process_write_data, encode_state_error);
             }
         }
     write_block_footer:
-        if (block_type == block_type_with_hashsum_integrity_check &&
+        if (block_type_integrity_checked(block_type) &&
             (state = write_block_footer(in, out)))
             return exit_process(process_write_block_footer, state);
+        count_block();
         goto write_block_header;
     }
     template<class KERNEL_ENCODE_T> DENSITY_INLINE encode_state_t
@@ -103,7 +132,7 @@ namespace density {
         kernel_encode_t::state_t kernel_encode_state;
         uint_fast64_t available_in_before, available_out_before;
         // Add to the integrity check hashsum
-        if (block_type == block_type_with_hashsum_integrity_check && update)
+        if (block_type_integrity_checked(block_type) && update)
             update_integrity_data(in);
         // Dispatch
         switch (process) {
@@ -151,21 +180,23 @@ namespace density {
             kernel_encode_state = kernel_encode.finish(in, out);
             update_totals(in, out, in->available_bytes(), out->available_bytes);
             switch (kernel_encode_state) {
-            case kernel_encode_t::state_stall_on_input: return encode_state_error;
+            case kernel_encode_t::state_stall_on_input:
+                return exit_process(process_write_data, encode_state_error);
             case kernel_encode_t::state_stall_on_output:
                 return exit_process(process_write_data, encode_state_stall_on_output);
             case kernel_encode_t::state_ready:
             case kernel_encode_t::state_info_new_block: goto write_block_footer;
             case kernel_encode_t::state_info_efficiency_check: goto write_mode_marker;
-            default: return encode_state_error;
+            default: return exit_process(process_write_data, encode_state_error);
             }
         }
     write_block_footer:
-        if (block_type == block_type_with_hashsum_integrity_check &&
+        if (block_type_integrity_checked(block_type) &&
             (state = write_block_footer(in, out)))
             return exit_process(process_write_block_footer, state);
+        count_block();
         if (in->available_bytes()) goto write_block_header;
-        return encode_state_ready;
+        return exit_process(process_write_block_header, encode_state_ready);
     }
 
     DENSITY_INLINE void
@@ -175,10 +206,10 @@ namespace density {
         const uint8_t *const pointer_after = in->direct.pointer;
         const uint_fast64_t processed = pointer_after - pointer_before;
         if (pending_exit) {
-            spooky.update(input_pointer, processed);
+            update_integrity_hash(input_pointer, processed);
             update = true;
         } else {
-            spooky.update(input_pointer, processed - in->staging.available_bytes);
+            update_integrity_hash(input_pointer, processed - in->staging.available_bytes);
             update_integrity_data(in);
         }
     }
@@ -197,9 +228,18 @@ namespace density {
         in_start = total_read;
         out_start = total_written;
 
-        if (block_type == block_type_with_hashsum_integrity_check) {
-            spooky.init(spookyhash_seed_1, spookyhash_seed_2);
-            spooky.update(in->staging.pointer, in->staging.available_bytes);
+        if (block_type_integrity_checked(block_type)) {
+            if (!helper) {
+                integrity_hash.init(block_type);
+                integrity_hash.update(in->staging.pointer, in->staging.available_bytes);
+            } else {
+                // The staging buffer is refilled before the next exit, hash a copy.
+                const std::vector<uint8_t> staged(in->staging.pointer, in->staging.pointer +
+                                                  in->staging.available_bytes);
+                helper->post([this, staged]() {
+                        integrity_hash.init(block_type);
+                        integrity_hash.update(staged.data(), staged.size()); });
+            }
             update_integrity_data(in);
         }
         return encode_state_ready;
@@ -210,8 +250,19 @@ namespace density {
         block_footer_t block_footer;
         if (sizeof(block_footer) > out->available_bytes) return encode_state_stall_on_output;
         update_integrity_hash(in, false);
-        spooky.final(&block_footer.hashsum1, &block_footer.hashsum2);
-        total_written += block_footer.write(out);
+        if (!helper) {
+            integrity_hash.final(&block_footer.hashsum1, &block_footer.hashsum2);
+            total_written += block_footer.write(out);
+        } else {
+            // Reserve the footer now, the helper fills it in before the next exit.
+            uint8_t *const footer_pointer = out->pointer;
+            out->consume(sizeof(block_footer));
+            total_written += sizeof(block_footer);
+            helper->post([this, footer_pointer]() {
+                    block_footer_t block_footer;
+                    integrity_hash.final(&block_footer.hashsum1, &block_footer.hashsum2);
+                    DENSITY_MEMCPY(footer_pointer, &block_footer, sizeof(block_footer)); });
+        }
         return encode_state_ready;
     }
     DENSITY_INLINE encode_state_t
@@ -235,10 +286,15 @@ namespace density {
         read_block_header_content = context.header.parameters().as_bytes[0] ? true: false;
         total_read = total_written = 0;
         end_data_overhead = context.end_data_overhead;
-        if (block_type == block_type_with_hashsum_integrity_check) {
+        if (block_type_integrity_checked(block_type)) {
             update = true;
             end_data_overhead += sizeof(block_footer_t);
         }
+        if (!block_type_integrity_checked(block_type) || !context.integrity_helper) {
+            delete helper;
+            helper = NULL;
+        } else if (!helper) helper = new parallel_helper_t();
+        integrity_failed = false;
         kernel_decode.init(context.header.parameters(), end_data_overhead);
         return exit_process(process_read_block_header, decode_state_ready);
     }
@@ -251,7 +307,7 @@ namespace density {
         kernel_decode_t::state_t kernel_decode_state;
         uint_fast64_t available_in_before, available_out_before;
         // Update integrity pointers
-        if (block_type == block_type_with_hashsum_integrity_check && update)
+        if (block_type_integrity_checked(block_type) && update)
             update_integrity_data(out);
         // Dispatch
         switch (process) {
@@ -289,7 +345,7 @@ namespace density {
                 else {
                     in->copy(out, out_remaining);
                     update_totals(in, out, available_in_before, available_out_before);
-                    if (block_type == block_type_with_hashsum_integrity_check)
+                    if (block_type_integrity_checked(block_type))
                         update_integrity_hash(out, true);
                     return exit_process(process_read_data, decode_state_stall_on_output);
                 }
@@ -305,16 +361,16 @@ namespace density {
             case kernel_decode_t::state_stall_on_input:
                 return exit_process(process_read_data, decode_state_stall_on_input);
             case kernel_decode_t::state_stall_on_output:
-                if (block_type == block_type_with_hashsum_integrity_check)
+                if (block_type_integrity_checked(block_type))
                     update_integrity_hash(out, true);
                 return exit_process(process_read_data, decode_state_stall_on_output);
             case kernel_decode_t::state_info_new_block: goto read_block_footer;
             case kernel_decode_t::state_info_efficiency_check: goto read_mode_marker;
-            default: return decode_state_error;
+            default: return exit_process(process_read_data, decode_state_error);
             }
         }
     read_block_footer:
-        if (block_type == block_type_with_hashsum_integrity_check &&
+        if (block_type_integrity_checked(block_type) &&
             (state = read_block_footer(in, out)))
             return exit_process(process_read_block_footer, state);
         goto read_block_header;
@@ -328,7 +384,7 @@ namespace density {
         kernel_decode_t::state_t kernel_decode_state;
         uint_fast64_t available_in_before, available_out_before;
         // Update integrity pointers
-        if (block_type == block_type_with_hashsum_integrity_check && update)
+        if (block_type_integrity_checked(block_type) && update)
             update_integrity_data(out);
         // Dispatch
         switch (process) {
@@ -365,7 +421,7 @@ namespace density {
                 else {
                     in->copy(out, out_remaining);
                     update_totals(in, out, available_in_before, available_out_before);
-                    if (block_type == block_type_with_hashsum_integrity_check)
+                    if (block_type_integrity_checked(block_type))
                         update_integrity_hash(out, true);
                     return exit_process(process_read_data, decode_state_stall_on_output);
                 }
@@ -378,23 +434,24 @@ namespace density {
             kernel_decode_state = kernel_decode.finish(in, out);
             update_totals(in, out, available_in_before, available_out_before);
             switch (kernel_decode_state) {
-            case kernel_decode_t::state_stall_on_input: return decode_state_error;
+            case kernel_decode_t::state_stall_on_input:
+                return exit_process(process_read_data, decode_state_error);
             case kernel_decode_t::state_stall_on_output:
-                if (block_type == block_type_with_hashsum_integrity_check)
+                if (block_type_integrity_checked(block_type))
                     update_integrity_hash(out, true);
                 return exit_process(process_read_data, decode_state_stall_on_output);
             case kernel_decode_t::state_ready:
             case kernel_decode_t::state_info_new_block: goto read_block_footer;
             case kernel_decode_t::state_info_efficiency_check: goto read_mode_marker;
-            default: return decode_state_error;
+            default: return exit_process(process_read_data, decode_state_error);
             }
         }
     read_block_footer:
-        if (block_type == block_type_with_hashsum_integrity_check &&
+        if (block_type_integrity_checked(block_type) &&
             (state = read_block_footer(in, out)))
             return exit_process(process_read_block_footer, state);
         if (in->available_bytes_reserved(end_data_overhead)) goto read_block_header;
-        return decode_state_ready;
+        return exit_process(process_read_block_header, decode_state_ready);
     }
 
     DENSITY_INLINE void
@@ -403,22 +460,25 @@ namespace density {
         const uint8_t *const pointer_before = output_pointer;
         const uint8_t *const pointer_after = out->pointer;
         const uint_fast64_t processed = pointer_after - pointer_before;
-        spooky.update(output_pointer, processed);
+        update_integrity_hash(output_pointer, processed);
         if (pending_exit) update = true;
         else update_integrity_data(out);
     }
     DENSITY_INLINE decode_state_t
     block_decode_base_t::read_block_header(teleport_t *in, location_t *out)
     {
-        location_t *read_location;
-        if (!(read_location = in->read_reserved(sizeof(last_block_header), end_data_overhead)))
+        location_t *read_location = NULL;
+        if (read_block_header_content &&
+            !(read_location = in->read_reserved(sizeof(last_block_header), end_data_overhead)))
             return decode_state_stall_on_input;
+        current_mode = target_mode;
         in_start = total_read;
         out_start = total_written;
         if (read_block_header_content)
             total_read += last_block_header.read(read_location);
-        if (block_type == block_type_with_hashsum_integrity_check) {
-            spooky.init(spookyhash_seed_1, spookyhash_seed_2);
+        if (block_type_integrity_checked(block_type)) {
+            if (!helper) integrity_hash.init(block_type);
+            else helper->post([this]() { integrity_hash.init(block_type); });
             update_integrity_data(out);
         }
         return decode_state_ready;
@@ -440,9 +500,19 @@ namespace density {
         if (!(read_location = in->read(sizeof(last_block_footer))))
             return decode_state_stall_on_input;
         update_integrity_hash(out, false);
-        uint64_t hashsum1, hashsum2;
-        spooky.final(&hashsum1, &hashsum2);
         total_read += last_block_footer.read(read_location);
+        if (helper) {
+            // Checked in the background, exit_process reports a mismatch.
+            block_footer_t block_footer = last_block_footer;
+            helper->post([this, block_footer]() mutable {
+                    uint64_t hashsum1, hashsum2;
+                    integrity_hash.final(&hashsum1, &hashsum2);
+                    if (!block_footer.check(hashsum1, hashsum2))
+                        integrity_failed = true; });
+            return decode_state_ready;
+        }
+        uint64_t hashsum1, hashsum2;
+        integrity_hash.final(&hashsum1, &hashsum2);
         return last_block_footer.check(hashsum1, hashsum2) ? decode_state_ready:
             decode_state_integrity_check_fail;
     }
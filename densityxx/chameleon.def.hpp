@@ -1,6 +1,7 @@
 // see LICENSE.md for license.
 #pragma once
 #include "densityxx/kernel.hpp"
+#include "densityxx/cpu.hpp"
 
 namespace density {
     typedef uint64_t chameleon_signature_t;
@@ -13,25 +14,37 @@ namespace density {
 #pragma pack(push)
 #pragma pack(4)
     //--- dictionary ---
-    class chameleon_dictionary_t {
+    template<uint_fast8_t HASH_BITS>class chameleon_dictionary_t {
     public:
         typedef struct {
             uint32_t as_uint32_t;
         } entry_t;
 
-        entry_t entries[1 << hash_bits];
-        DENSITY_INLINE void reset(void) { memset(entries, 0, sizeof(entries)); }
+        entry_t entries[1 << HASH_BITS];
+        dictionary_slots_t<HASH_BITS> written;
+        DENSITY_INLINE void touch(const uint16_t hash) { written.touch(hash); }
+        DENSITY_INLINE void reset(void)
+        {   if (written.overflown()) memset(entries, 0, sizeof(entries));
+            else for (uint_fast32_t idx = 0; idx < written.count; ++idx)
+                     entries[written.slots[idx]].as_uint32_t = 0;
+            written.clear(); }
     };
 
     //--- encode ---
+    template<uint_fast8_t HASH_BITS, class STATS_T = stats_off_t>
     class chameleon_encode_t: public kernel_encode_t {
     public:
+        typedef chameleon_dictionary_t<HASH_BITS> dictionary_t;
+
         DENSITY_INLINE compression_mode_t mode(void) const
         {   return compression_mode_chameleon_algorithm; }
 
         state_t init(void);
         state_t continue_(teleport_t *in, location_t *out);
         state_t finish(teleport_t *in, location_t *out);
+        DENSITY_INLINE void set_stats(stats_t *counters) { stats.attach(counters); }
+        // Also counted in by the block encoder.
+        STATS_T stats;
     private:
         typedef enum {
             process_prepare_new_block,
@@ -49,10 +62,11 @@ namespace density {
         bool signature_copied_to_memory;
 
         process_t process;
-        chameleon_dictionary_t dictionary;
+        dictionary_t dictionary;
 #if DENSITY_ENABLE_PARALLELIZABLE_DECOMPRESSIBLE_OUTPUT == DENSITY_YES
         uint_fast64_t reset_cycle;
 #endif
+        cpu_simd_t simd;
 
         DENSITY_INLINE state_t exit_process(process_t process, state_t kernel_encode_state)
         {   this->process = process; return kernel_encode_state; }
@@ -60,12 +74,19 @@ namespace density {
         state_t prepare_new_block(location_t *out);
         state_t check_state(location_t *out);
         void kernel(location_t *out, const uint16_t, const uint32_t, const uint_fast8_t);
+        void process_run(location_t *in, location_t *out);
         void process_unit(location_t *in, location_t *out);
+#if DENSITY_X86_SIMD == DENSITY_YES
+        DENSITY_TARGET("sse4.1") void process_unit_sse41(location_t *in, location_t *out);
+        DENSITY_TARGET("avx2") void process_unit_avx2(location_t *in, location_t *out);
+#endif
     };
 
     //--- decode ---
-    class chameleon_decode_t: public kernel_decode_t {
+    template<uint_fast8_t HASH_BITS>class chameleon_decode_t: public kernel_decode_t {
     public:
+        typedef chameleon_dictionary_t<HASH_BITS> dictionary_t;
+
         DENSITY_INLINE compression_mode_t mode(void) const
         {   return compression_mode_chameleon_algorithm; }
 
@@ -88,24 +109,32 @@ namespace density {
         process_t process;
         uint_fast8_t end_data_overhead;
         main_header_parameters_t parameters;
-        chameleon_dictionary_t dictionary;
+        dictionary_t dictionary;
         uint_fast64_t reset_cycle;
+        cpu_simd_t simd;
 
         DENSITY_INLINE state_t exit_process(process_t process, state_t kernel_decode_state)
         {   this->process = process; return kernel_decode_state; }
         state_t check_state(location_t *out);
         void read_signature(location_t *in);
         DENSITY_INLINE void process_compressed(const uint16_t hash, location_t *out)
-        {   DENSITY_MEMCPY(out->pointer, &dictionary.entries[hash].as_uint32_t,
+        {   DENSITY_MEMCPY(out->pointer,
+                           &dictionary.entries[hash_mask<HASH_BITS>(hash)].as_uint32_t,
                            sizeof(uint32_t)); }
         DENSITY_INLINE void process_uncompressed(const uint32_t chunk, location_t *out)
-        {   const uint16_t hash = hash_algorithm(chunk);
+        {   const uint16_t hash = hash_algorithm<HASH_BITS>(chunk);
             dictionary.entries[hash].as_uint32_t = chunk;
+            dictionary.touch(hash);
             DENSITY_MEMCPY(out->pointer, &chunk, sizeof(uint32_t)); }
         void kernel(location_t *in, location_t *out, const bool compressed);
         DENSITY_INLINE const bool test_compressed(const uint_fast8_t shift) const
         {   return (bool)((signature >> shift) & chameleon_signature_flag_map); }
+        bool process_run(location_t *in, location_t *out);
         void process_data(location_t *in, location_t *out);
+#if DENSITY_X86_SIMD == DENSITY_YES
+        DENSITY_TARGET("sse4.1") void process_data_sse41(location_t *in, location_t *out);
+        DENSITY_TARGET("avx2") void process_data_avx2(location_t *in, location_t *out);
+#endif
     };
 #pragma pack(pop)
 }
@@ -42,8 +42,8 @@ namespace density {
     const uint_fast64_t chameleon_encode_process_unit_size =
         DENSITY_BITSIZEOF(chameleon_signature_t) * sizeof(uint32_t);
 
-    DENSITY_INLINE void
-    chameleon_encode_t::prepare_new_signature(location_t *out)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    chameleon_encode_t<HASH_BITS, STATS_T>::prepare_new_signature(location_t *out)
     {
         signatures_count++;
         shift = 0;
@@ -55,8 +55,8 @@ namespace density {
         out->available_bytes -= sizeof(chameleon_signature_t);
     }
 
-    DENSITY_INLINE kernel_encode_t::state_t
-    chameleon_encode_t::prepare_new_block(location_t *out)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    chameleon_encode_t<HASH_BITS, STATS_T>::prepare_new_block(location_t *out)
     {
         if (chameleon_maximum_compressed_unit_size > out->available_bytes)
             return state_stall_on_output;
@@ -84,8 +84,8 @@ namespace density {
         return state_ready;
     }
 
-    DENSITY_INLINE kernel_encode_t::state_t
-    chameleon_encode_t::check_state(location_t *out)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    chameleon_encode_t<HASH_BITS, STATS_T>::check_state(location_t *out)
     {
         state_t kernel_encode_state;
         switch (shift) {
@@ -102,41 +102,78 @@ namespace density {
         return state_ready;
     }
 
-    DENSITY_INLINE void
-    chameleon_encode_t::kernel(location_t *out, const uint16_t hash,
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    chameleon_encode_t<HASH_BITS, STATS_T>::kernel(location_t *out, const uint16_t hash,
                                const uint32_t chunk, const uint_fast8_t shift)
     {
-        chameleon_dictionary_t::entry_t *const found = &dictionary.entries[hash];
+        typename dictionary_t::entry_t *const found = &dictionary.entries[hash];
         if (chunk != found->as_uint32_t) {
             found->as_uint32_t = chunk;
+            dictionary.touch(hash);
+            stats.chameleon(0, 1);
             //DENSITY_SHOW_OUT(out, sizeof(chunk));
             DENSITY_MEMCPY(out->pointer, &chunk, sizeof(chunk));
             out->pointer += sizeof(chunk);
         } else {
             proximity_signature |= ((uint64_t)chameleon_signature_flag_map << shift);
+            stats.chameleon(1, 1);
             //DENSITY_SHOW_OUT(out, sizeof(hash));
             DENSITY_MEMCPY(out->pointer, &hash, sizeof(hash));
             out->pointer += sizeof(hash);
         }
     }
 
-    DENSITY_INLINE void
-    chameleon_encode_t::process_unit(location_t *in, location_t *out)
+    // The first chunk of a run may be new to the dictionary, the others are all found there
+    // under its hash.
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    chameleon_encode_t<HASH_BITS, STATS_T>::process_run(location_t *in, location_t *out)
+    {
+        uint32_t chunk;
+        DENSITY_MEMCPY(&chunk, in->pointer, sizeof(chunk));
+        const uint16_t hash = hash_algorithm<HASH_BITS>(chunk);
+        kernel(out, hash, chunk, 0);
+        proximity_signature |= ~(chameleon_signature_t)chameleon_signature_flag_map;
+        stats.chameleon(DENSITY_BITSIZEOF(chameleon_signature_t) - 1,
+                        DENSITY_BITSIZEOF(chameleon_signature_t) - 1);
+        uint8_t *pointer = out->pointer;
+        for (uint_fast8_t count = 1; count < DENSITY_BITSIZEOF(chameleon_signature_t);
+             ++count) {
+            DENSITY_MEMCPY(pointer, &hash, sizeof(hash));
+            pointer += sizeof(hash);
+        }
+        out->pointer = pointer;
+        in->pointer += chameleon_encode_process_unit_size;
+        shift = DENSITY_BITSIZEOF(chameleon_signature_t);
+    }
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    chameleon_encode_t<HASH_BITS, STATS_T>::process_unit(location_t *in, location_t *out)
     {
         uint32_t chunk;
         uint_fast8_t count = 0;
+        if (DENSITY_UNLIKELY(kernel_run(in->pointer, chameleon_encode_process_unit_size,
+                                        sizeof(chunk)))) {
+            process_run(in, out);
+            return;
+        }
+#if DENSITY_X86_SIMD == DENSITY_YES
+        switch (simd) {
+        case cpu_simd_avx2: process_unit_avx2(in, out); return;
+        case cpu_simd_sse41: process_unit_sse41(in, out); return;
+        default: break;
+        }
+#endif
         //DENSITY_SHOW_IN(in, 64 * sizeof(uint32_t));
 #ifdef __clang__
         for (uint_fast8_t count_b = 0; count_b < 32; count_b++) {
             DENSITY_UNROLL_2(DENSITY_MEMCPY(&chunk, in->pointer, sizeof(uint32_t)); \
-                             kernel(out, hash_algorithm(chunk), chunk, count++); \
+                             kernel(out, hash_algorithm<HASH_BITS>(chunk), chunk, count++); \
                              in->pointer += sizeof(uint32_t);           \
                              );
         }
 #else
         for (uint_fast8_t count_b = 0; count_b < 16; count_b++) {
             DENSITY_UNROLL_4(DENSITY_MEMCPY(&chunk, in->pointer, sizeof(uint32_t)); \
-                             kernel(out, hash_algorithm(chunk), chunk, count++); \
+                             kernel(out, hash_algorithm<HASH_BITS>(chunk), chunk, count++); \
                              in->pointer += sizeof(uint32_t);           \
                              );
         }
@@ -144,19 +181,145 @@ namespace density {
         shift = DENSITY_BITSIZEOF(chameleon_signature_t);
     }
 
-    DENSITY_INLINE kernel_encode_t::state_t
-    chameleon_encode_t::init(void)
+#if DENSITY_X86_SIMD == DENSITY_YES
+    // Output bytes of 4 chunks indexed by their signature bits: the 2 hash bytes of the
+    // chunks found in the dictionary, the 4 bytes of the others.
+    typedef struct {
+        uint8_t shuffle[16];
+        uint8_t length;
+    } chameleon_compaction_t;
+    static const chameleon_compaction_t chameleon_compactions[16] = {
+        {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}, 16},
+        {{0, 1, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0x80, 0x80}, 14},
+        {{0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, 14, 15, 0x80, 0x80}, 14},
+        {{0, 1, 4, 5, 8, 9, 10, 11, 12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80}, 12},
+        {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 12, 13, 14, 15, 0x80, 0x80}, 14},
+        {{0, 1, 4, 5, 6, 7, 8, 9, 12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80}, 12},
+        {{0, 1, 2, 3, 4, 5, 8, 9, 12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80}, 12},
+        {{0, 1, 4, 5, 8, 9, 12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80}, 10},
+        {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 0x80, 0x80}, 14},
+        {{0, 1, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 0x80, 0x80, 0x80, 0x80}, 12},
+        {{0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, 0x80, 0x80, 0x80, 0x80}, 12},
+        {{0, 1, 4, 5, 8, 9, 10, 11, 12, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80}, 10},
+        {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 12, 13, 0x80, 0x80, 0x80, 0x80}, 12},
+        {{0, 1, 4, 5, 6, 7, 8, 9, 12, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80}, 10},
+        {{0, 1, 2, 3, 4, 5, 8, 9, 12, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80}, 10},
+        {{0, 1, 4, 5, 8, 9, 12, 13, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80}, 8},
+    };
+
+    // Encodes 4 chunks given the dictionary entries they meet, the chunks not found are
+    // added to the dictionary in order. Returns their signature bits.
+    template<class DICTIONARY_T>static DENSITY_TARGET("sse4.1") DENSITY_INLINE uint_fast8_t
+    chameleon_encode_group_sse41(DICTIONARY_T &dictionary, location_t *out,
+                                 const __m128i chunk, const __m128i hash, const __m128i found)
+    {
+        uint32_t chunks[4], hashes[4];
+        const __m128i match = _mm_cmpeq_epi32(found, chunk);
+        const uint_fast8_t map = (uint_fast8_t)_mm_movemask_ps(_mm_castsi128_ps(match));
+        uint_fast8_t miss = (uint_fast8_t)(~map & 0xf);
+        const chameleon_compaction_t &compaction = chameleon_compactions[map];
+        if (miss) {
+            _mm_storeu_si128((__m128i *)chunks, chunk);
+            _mm_storeu_si128((__m128i *)hashes, hash);
+            do {
+                const int lane = __builtin_ctz(miss);
+                dictionary.entries[hashes[lane]].as_uint32_t = chunks[lane];
+                dictionary.touch((uint16_t)hashes[lane]);
+                miss &= miss - 1;
+            } while (miss);
+        }
+        // A unit is never more than 16 bytes per group, the store stays in it.
+        _mm_storeu_si128((__m128i *)out->pointer,
+                         _mm_shuffle_epi8(_mm_blendv_epi8(chunk, hash, match),
+                                          _mm_loadu_si128((const __m128i *)compaction.shuffle)));
+        out->pointer += compaction.length;
+        return map;
+    }
+    // A chunk meets the chunk PRECEDING lanes before it instead of the dictionary entry
+    // when they hash alike, the scalar kernel would have just stored it there.
+#define DENSITY_CHAMELEON_SSE41_PRECEDING(PRECEDING)                    \
+    found = _mm_blendv_epi8(found, _mm_alignr_epi8(chunk, none, 16 - 4 * (PRECEDING)), \
+                            _mm_cmpeq_epi32(hash, _mm_alignr_epi8(hash, none, 16 - 4 * (PRECEDING))))
+    template<uint_fast8_t HASH_BITS, class STATS_T> void
+    chameleon_encode_t<HASH_BITS, STATS_T>::process_unit_sse41(location_t *in, location_t *out)
+    {
+        const __m128i multiplier = _mm_set1_epi32((int)hash_multiplier);
+        const __m128i none = _mm_set1_epi32(-1);
+        for (uint_fast8_t group = 0; group < 16; ++group) {
+            const __m128i chunk = _mm_loadu_si128((const __m128i *)in->pointer);
+            const __m128i hash = _mm_srli_epi32(_mm_mullo_epi32(chunk, multiplier),
+                                                32 - HASH_BITS);
+            __m128i found = _mm_setr_epi32
+                ((int)dictionary.entries[_mm_extract_epi32(hash, 0)].as_uint32_t,
+                 (int)dictionary.entries[_mm_extract_epi32(hash, 1)].as_uint32_t,
+                 (int)dictionary.entries[_mm_extract_epi32(hash, 2)].as_uint32_t,
+                 (int)dictionary.entries[_mm_extract_epi32(hash, 3)].as_uint32_t);
+            DENSITY_CHAMELEON_SSE41_PRECEDING(3);
+            DENSITY_CHAMELEON_SSE41_PRECEDING(2);
+            DENSITY_CHAMELEON_SSE41_PRECEDING(1);
+            const uint_fast8_t map =
+                chameleon_encode_group_sse41(dictionary, out, chunk, hash, found);
+            stats.chameleon(__builtin_popcount(map), 4);
+            proximity_signature |= (chameleon_signature_t)map << (group << 2);
+            in->pointer += sizeof(__m128i);
+        }
+        shift = DENSITY_BITSIZEOF(chameleon_signature_t);
+    }
+#undef DENSITY_CHAMELEON_SSE41_PRECEDING
+    // 8 chunks at once, the dictionary entries are gathered before any of them is updated.
+    template<uint_fast8_t HASH_BITS, class STATS_T> void
+    chameleon_encode_t<HASH_BITS, STATS_T>::process_unit_avx2(location_t *in, location_t *out)
+    {
+        const __m256i multiplier = _mm256_set1_epi32((int)hash_multiplier);
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        for (uint_fast8_t group = 0; group < 8; ++group) {
+            const __m256i chunk = _mm256_loadu_si256((const __m256i *)in->pointer);
+            const __m256i hash = _mm256_srli_epi32(_mm256_mullo_epi32(chunk, multiplier),
+                                                   32 - HASH_BITS);
+            __m256i found = _mm256_i32gather_epi32((const int *)dictionary.entries, hash,
+                                                   sizeof(uint32_t));
+            // The closest preceding chunk hashing alike wins, see the SSE4.1 version.
+            for (int preceding = 7; preceding; --preceding) {
+                const __m256i source =
+                    _mm256_and_si256(_mm256_sub_epi32(lanes, _mm256_set1_epi32(preceding)),
+                                     _mm256_set1_epi32(7));
+                const __m256i alike =
+                    _mm256_and_si256(_mm256_cmpeq_epi32
+                                     (hash, _mm256_permutevar8x32_epi32(hash, source)),
+                                     _mm256_cmpgt_epi32(lanes,
+                                                        _mm256_set1_epi32(preceding - 1)));
+                found = _mm256_blendv_epi8(found, _mm256_permutevar8x32_epi32(chunk, source),
+                                           alike);
+            }
+            const uint_fast8_t low_map = chameleon_encode_group_sse41
+                (dictionary, out, _mm256_castsi256_si128(chunk), _mm256_castsi256_si128(hash),
+                 _mm256_castsi256_si128(found));
+            const uint_fast8_t high_map = chameleon_encode_group_sse41
+                (dictionary, out, _mm256_extracti128_si256(chunk, 1),
+                 _mm256_extracti128_si256(hash, 1), _mm256_extracti128_si256(found, 1));
+            stats.chameleon(__builtin_popcount(low_map | (high_map << 4)), 8);
+            proximity_signature |= (chameleon_signature_t)(low_map | (high_map << 4)) <<
+                (group << 3);
+            in->pointer += sizeof(__m256i);
+        }
+        shift = DENSITY_BITSIZEOF(chameleon_signature_t);
+    }
+#endif
+
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    chameleon_encode_t<HASH_BITS, STATS_T>::init(void)
     {
         signatures_count = 0;
         efficiency_checked = 0;
         dictionary.reset();
+        simd = cpu_simd();
 #if DENSITY_ENABLE_PARALLELIZABLE_DECOMPRESSIBLE_OUTPUT == DENSITY_YES
         reset_cycle = dictionary_preferred_reset_cycle - 1;
 #endif
         return exit_process(process_prepare_new_block, state_ready);
     }
-    DENSITY_INLINE kernel_encode_t::state_t
-    chameleon_encode_t::continue_(teleport_t *in, location_t *out)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    chameleon_encode_t<HASH_BITS, STATS_T>::continue_(teleport_t *in, location_t *out)
     {
         state_t return_state;
         uint8_t *pointer_out_before;
@@ -188,8 +351,8 @@ namespace density {
         // New loop
         goto check_signature_state;
     }
-    DENSITY_INLINE kernel_encode_t::state_t
-    chameleon_encode_t::finish(teleport_t *in, location_t *out)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    chameleon_encode_t<HASH_BITS, STATS_T>::finish(teleport_t *in, location_t *out)
     {
         state_t return_state;
         uint8_t *pointer_out_before;
@@ -224,7 +387,7 @@ namespace density {
                (read_memory_location = in->read(sizeof(uint32_t)))) {
             uint32_t chunk;
             DENSITY_MEMCPY(&chunk, read_memory_location->pointer, sizeof(chunk));
-            kernel(out, hash_algorithm(chunk), chunk, shift);
+            kernel(out, hash_algorithm<HASH_BITS>(chunk), chunk, shift);
             ++shift;
             read_memory_location->pointer += sizeof(chunk);
             read_memory_location->available_bytes -= sizeof(chunk);
@@ -239,8 +402,8 @@ namespace density {
     }
 
     //--- decode ---
-    DENSITY_INLINE kernel_decode_t::state_t
-    chameleon_decode_t::check_state(location_t *out)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    chameleon_decode_t<HASH_BITS>::check_state(location_t *out)
     {
         if (out->available_bytes < chameleon_decompressed_unit_size)
             return state_stall_on_output;
@@ -268,8 +431,8 @@ namespace density {
         return state_ready;
     }
 
-    DENSITY_INLINE void
-    chameleon_decode_t::read_signature(location_t *in)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    chameleon_decode_t<HASH_BITS>::read_signature(location_t *in)
     {
         //DENSITY_SHOW_IN(in, sizeof(signature));
         DENSITY_MEMCPY(&signature, in->pointer, sizeof(signature));
@@ -278,8 +441,9 @@ namespace density {
         signatures_count++;
     }
 
-    DENSITY_INLINE void
-    chameleon_decode_t::kernel(location_t *in, location_t *out, const bool compressed)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    chameleon_decode_t<HASH_BITS>::kernel(location_t *in, location_t *out,
+                                          const bool compressed)
     {
         if (compressed) {
             uint16_t hash;
@@ -298,10 +462,35 @@ namespace density {
         out->pointer += sizeof(uint32_t);
     }
 
-    DENSITY_INLINE void
-    chameleon_decode_t::process_data(location_t *in, location_t *out)
+    // A unit of chunks all found in the dictionary under the same hash is a run.
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE bool
+    chameleon_decode_t<HASH_BITS>::process_run(location_t *in, location_t *out)
+    {
+        const uint_fast64_t hashes_size = DENSITY_BITSIZEOF(chameleon_signature_t) *
+            sizeof(uint16_t);
+        uint16_t hash;
+        if (DENSITY_LIKELY(~signature) || !kernel_run(in->pointer, hashes_size, sizeof(hash)))
+            return false;
+        DENSITY_MEMCPY(&hash, in->pointer, sizeof(hash));
+        kernel_fill(out->pointer, dictionary.entries[hash_mask<HASH_BITS>(hash)].as_uint32_t,
+                    DENSITY_BITSIZEOF(chameleon_signature_t));
+        in->pointer += hashes_size;
+        out->pointer += chameleon_decompressed_unit_size;
+        shift = DENSITY_BITSIZEOF(chameleon_signature_t);
+        return true;
+    }
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    chameleon_decode_t<HASH_BITS>::process_data(location_t *in, location_t *out)
     {
         uint_fast8_t count = 0;
+        if (DENSITY_UNLIKELY(process_run(in, out))) return;
+#if DENSITY_X86_SIMD == DENSITY_YES
+        switch (simd) {
+        case cpu_simd_avx2: process_data_avx2(in, out); return;
+        case cpu_simd_sse41: process_data_sse41(in, out); return;
+        default: break;
+        }
+#endif
 #ifdef __clang__
         for(uint_fast8_t count_b = 0; count_b < 8; count_b ++) {
             DENSITY_UNROLL_8(kernel(in, out, test_compressed(count++)));
@@ -314,13 +503,156 @@ namespace density {
         shift = DENSITY_BITSIZEOF(chameleon_signature_t);
     }
 
-    DENSITY_INLINE kernel_decode_t::state_t
-    chameleon_decode_t::init(const main_header_parameters_t parameters,
+#if DENSITY_X86_SIMD == DENSITY_YES
+    // Input bytes of 4 chunks indexed by their signature bits, the inverse of
+    // chameleon_compactions: the hashes are widened to 4 bytes.
+    static const chameleon_compaction_t chameleon_expansions[16] = {
+        {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}, 16},
+        {{0, 1, 0x80, 0x80, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13}, 14},
+        {{0, 1, 2, 3, 4, 5, 0x80, 0x80, 6, 7, 8, 9, 10, 11, 12, 13}, 14},
+        {{0, 1, 0x80, 0x80, 2, 3, 0x80, 0x80, 4, 5, 6, 7, 8, 9, 10, 11}, 12},
+        {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0x80, 0x80, 10, 11, 12, 13}, 14},
+        {{0, 1, 0x80, 0x80, 2, 3, 4, 5, 6, 7, 0x80, 0x80, 8, 9, 10, 11}, 12},
+        {{0, 1, 2, 3, 4, 5, 0x80, 0x80, 6, 7, 0x80, 0x80, 8, 9, 10, 11}, 12},
+        {{0, 1, 0x80, 0x80, 2, 3, 0x80, 0x80, 4, 5, 0x80, 0x80, 6, 7, 8, 9}, 10},
+        {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 0x80, 0x80}, 14},
+        {{0, 1, 0x80, 0x80, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 0x80, 0x80}, 12},
+        {{0, 1, 2, 3, 4, 5, 0x80, 0x80, 6, 7, 8, 9, 10, 11, 0x80, 0x80}, 12},
+        {{0, 1, 0x80, 0x80, 2, 3, 0x80, 0x80, 4, 5, 6, 7, 8, 9, 0x80, 0x80}, 10},
+        {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0x80, 0x80, 10, 11, 0x80, 0x80}, 12},
+        {{0, 1, 0x80, 0x80, 2, 3, 4, 5, 6, 7, 0x80, 0x80, 8, 9, 0x80, 0x80}, 10},
+        {{0, 1, 2, 3, 4, 5, 0x80, 0x80, 6, 7, 0x80, 0x80, 8, 9, 0x80, 0x80}, 10},
+        {{0, 1, 0x80, 0x80, 2, 3, 0x80, 0x80, 4, 5, 0x80, 0x80, 6, 7, 0x80, 0x80}, 8},
+    };
+
+    // Stores the chunks not found in the dictionary, in order.
+    template<class DICTIONARY_T>static DENSITY_INLINE void
+    chameleon_decode_update(DICTIONARY_T &dictionary, const uint32_t *hashes,
+                            const uint32_t *chunks, uint_fast8_t miss)
+    {
+        while (miss) {
+            const int lane = __builtin_ctz(miss);
+            dictionary.entries[hashes[lane]].as_uint32_t = chunks[lane];
+            dictionary.touch((uint16_t)hashes[lane]);
+            miss &= miss - 1;
+        }
+    }
+    // A hash meets the chunk PRECEDING lanes before it when that one is not compressed and
+    // hashes alike, the scalar kernel would have just stored it there.
+#define DENSITY_CHAMELEON_SSE41_PRECEDING(PRECEDING)                    \
+    found = _mm_blendv_epi8(found, _mm_alignr_epi8(data, none, 16 - 4 * (PRECEDING)), \
+                            _mm_andnot_si128(_mm_alignr_epi8(compressed, none, \
+                                                             16 - 4 * (PRECEDING)), \
+                                             _mm_cmpeq_epi32(hash, _mm_alignr_epi8 \
+                                                             (hash, none, 16 - 4 * (PRECEDING)))))
+    template<uint_fast8_t HASH_BITS> void
+    chameleon_decode_t<HASH_BITS>::process_data_sse41(location_t *in, location_t *out)
+    {
+        uint32_t chunks[4], hashes[4];
+        const __m128i multiplier = _mm_set1_epi32((int)hash_multiplier);
+        const __m128i mask = _mm_set1_epi32((1 << HASH_BITS) - 1);
+        const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+        const __m128i none = _mm_set1_epi32(-1);
+        for (uint_fast8_t group = 0; group < 16; ++group) {
+            const uint_fast8_t map = (uint_fast8_t)((signature >> (group << 2)) & 0xf);
+            const chameleon_compaction_t &expansion = chameleon_expansions[map];
+            // A unit is reserved whole, the load stays in it.
+            const __m128i data =
+                _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)in->pointer),
+                                 _mm_loadu_si128((const __m128i *)expansion.shuffle));
+            in->pointer += expansion.length;
+            const __m128i compressed =
+                _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(map), bits), bits);
+            const __m128i hash =
+                _mm_blendv_epi8(_mm_srli_epi32(_mm_mullo_epi32(data, multiplier),
+                                               32 - HASH_BITS),
+                                _mm_and_si128(data, mask), compressed);
+            __m128i found = _mm_setr_epi32
+                ((int)dictionary.entries[_mm_extract_epi32(hash, 0)].as_uint32_t,
+                 (int)dictionary.entries[_mm_extract_epi32(hash, 1)].as_uint32_t,
+                 (int)dictionary.entries[_mm_extract_epi32(hash, 2)].as_uint32_t,
+                 (int)dictionary.entries[_mm_extract_epi32(hash, 3)].as_uint32_t);
+            DENSITY_CHAMELEON_SSE41_PRECEDING(3);
+            DENSITY_CHAMELEON_SSE41_PRECEDING(2);
+            DENSITY_CHAMELEON_SSE41_PRECEDING(1);
+            _mm_storeu_si128((__m128i *)out->pointer, _mm_blendv_epi8(data, found, compressed));
+            out->pointer += sizeof(__m128i);
+            if (map != 0xf) {
+                _mm_storeu_si128((__m128i *)chunks, data);
+                _mm_storeu_si128((__m128i *)hashes, hash);
+                chameleon_decode_update(dictionary, hashes, chunks, (uint_fast8_t)(~map & 0xf));
+            }
+        }
+        shift = DENSITY_BITSIZEOF(chameleon_signature_t);
+    }
+#undef DENSITY_CHAMELEON_SSE41_PRECEDING
+    // 8 chunks per signature byte, the dictionary entries are gathered before any of them
+    // is updated.
+    template<uint_fast8_t HASH_BITS> void
+    chameleon_decode_t<HASH_BITS>::process_data_avx2(location_t *in, location_t *out)
+    {
+        uint32_t chunks[8], hashes[8];
+        const __m256i multiplier = _mm256_set1_epi32((int)hash_multiplier);
+        const __m256i mask = _mm256_set1_epi32((1 << HASH_BITS) - 1);
+        const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        for (uint_fast8_t group = 0; group < 8; ++group) {
+            const uint_fast8_t map = (uint_fast8_t)((signature >> (group << 3)) & 0xff);
+            const chameleon_compaction_t &low = chameleon_expansions[map & 0xf];
+            const chameleon_compaction_t &high = chameleon_expansions[map >> 4];
+            const __m128i low_data =
+                _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)in->pointer),
+                                 _mm_loadu_si128((const __m128i *)low.shuffle));
+            const __m128i high_data =
+                _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in->pointer + low.length)),
+                                 _mm_loadu_si128((const __m128i *)high.shuffle));
+            in->pointer += low.length + high.length;
+            const __m256i data =
+                _mm256_inserti128_si256(_mm256_castsi128_si256(low_data), high_data, 1);
+            const __m256i compressed =
+                _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(map), bits), bits);
+            const __m256i hash =
+                _mm256_blendv_epi8(_mm256_srli_epi32(_mm256_mullo_epi32(data, multiplier),
+                                                     32 - HASH_BITS),
+                                   _mm256_and_si256(data, mask), compressed);
+            __m256i found = _mm256_i32gather_epi32((const int *)dictionary.entries, hash,
+                                                   sizeof(uint32_t));
+            // The closest preceding chunk stored alike wins, see the SSE4.1 version.
+            for (int preceding = 7; preceding; --preceding) {
+                const __m256i source =
+                    _mm256_and_si256(_mm256_sub_epi32(lanes, _mm256_set1_epi32(preceding)),
+                                     _mm256_set1_epi32(7));
+                const __m256i alike =
+                    _mm256_andnot_si256(_mm256_permutevar8x32_epi32(compressed, source),
+                                        _mm256_and_si256
+                                        (_mm256_cmpeq_epi32
+                                         (hash, _mm256_permutevar8x32_epi32(hash, source)),
+                                         _mm256_cmpgt_epi32(lanes,
+                                                            _mm256_set1_epi32(preceding - 1))));
+                found = _mm256_blendv_epi8(found, _mm256_permutevar8x32_epi32(data, source),
+                                           alike);
+            }
+            _mm256_storeu_si256((__m256i *)out->pointer,
+                                _mm256_blendv_epi8(data, found, compressed));
+            out->pointer += sizeof(__m256i);
+            if (map != 0xff) {
+                _mm256_storeu_si256((__m256i *)chunks, data);
+                _mm256_storeu_si256((__m256i *)hashes, hash);
+                chameleon_decode_update(dictionary, hashes, chunks, (uint_fast8_t)~map);
+            }
+        }
+        shift = DENSITY_BITSIZEOF(chameleon_signature_t);
+    }
+#endif
+
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    chameleon_decode_t<HASH_BITS>::init(const main_header_parameters_t parameters,
                              const uint_fast8_t end_data_overhead)
     {
         signatures_count = 0;
         efficiency_checked = 0;
         dictionary.reset();
+        simd = cpu_simd();
         this->parameters = parameters;
         uint8_t reset_dictionary_cycle_shift = parameters.as_bytes[0];
         if (reset_dictionary_cycle_shift)
@@ -328,8 +660,8 @@ namespace density {
         this->end_data_overhead = end_data_overhead;
         return exit_process(process_check_signature_state, state_ready);
     }
-    DENSITY_INLINE kernel_decode_t::state_t
-    chameleon_decode_t::continue_(teleport_t *in, location_t *out)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    chameleon_decode_t<HASH_BITS>::continue_(teleport_t *in, location_t *out)
     {
         state_t return_state;
         location_t *read_memory_location;
@@ -358,8 +690,8 @@ namespace density {
         // New loop
         goto check_signature_state;
     }
-    DENSITY_INLINE kernel_decode_t::state_t
-    chameleon_decode_t::finish(teleport_t *in, location_t *out)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    chameleon_decode_t<HASH_BITS>::finish(teleport_t *in, location_t *out)
     {
         state_t return_state;
         location_t *read_memory_location;
@@ -16,7 +16,7 @@ namespace density {
 #pragma pack(push)
 #pragma pack(4)
     //--- dictionary ---
-    class cheetah_dictionary_t {
+    template<uint_fast8_t HASH_BITS>class cheetah_dictionary_t {
     public:
         typedef struct {
             uint32_t chunk_a, chunk_b;
@@ -25,20 +25,37 @@ namespace density {
         uint32_t next_chunk_prediction;
         } prediction_entry_t;
 
-        entry_t entries[1 << hash_bits];
-        prediction_entry_t prediction_entries[1 << hash_bits];
-        DENSITY_INLINE void reset(void) { memset(this, 0, sizeof(*this)); }
+        entry_t entries[1 << HASH_BITS];
+        prediction_entry_t prediction_entries[1 << HASH_BITS];
+        dictionary_slots_t<HASH_BITS> written;
+        DENSITY_INLINE void touch(const uint16_t hash) { written.touch(hash); }
+        DENSITY_INLINE void reset(void)
+        {   if (written.overflown()) {
+                memset(entries, 0, sizeof(entries));
+                memset(prediction_entries, 0, sizeof(prediction_entries));
+            } else for (uint_fast32_t idx = 0; idx < written.count; ++idx) {
+                    const uint16_t hash = written.slots[idx];
+                    entries[hash].chunk_a = entries[hash].chunk_b = 0;
+                    prediction_entries[hash].next_chunk_prediction = 0;
+                }
+            written.clear(); }
     };
 
     //--- encode ---
+    template<uint_fast8_t HASH_BITS, class STATS_T = stats_off_t>
     class cheetah_encode_t: public kernel_encode_t {
     public:
+        typedef cheetah_dictionary_t<HASH_BITS> dictionary_t;
+
         DENSITY_INLINE compression_mode_t mode(void) const
         {   return compression_mode_cheetah_algorithm; }
 
         state_t init(void);
         state_t continue_(teleport_t *in, location_t *out);
         state_t finish(teleport_t *in, location_t *out);
+        DENSITY_INLINE void set_stats(stats_t *counters) { stats.attach(counters); }
+        // Also counted in by the block encoder.
+        STATS_T stats;
     private:
         typedef enum {
             process_prepare_new_block,
@@ -55,7 +72,7 @@ namespace density {
         bool efficiency_checked;
         bool signature_copied_to_memory;
         process_t process;
-        cheetah_dictionary_t dictionary;
+        dictionary_t dictionary;
 #if DENSITY_ENABLE_PARALLELIZABLE_DECOMPRESSIBLE_OUTPUT == DENSITY_YES
         uint_fast64_t reset_cycle;
 #endif
@@ -66,12 +83,15 @@ namespace density {
         state_t check_state(location_t *out);
         void kernel(location_t *out, const uint16_t hash,
                     const uint32_t chunk, const uint_fast8_t shift);
+        void process_run(location_t *in, location_t *out);
         void process_unit(location_t *in, location_t *out);
     };
 
     //--- decode ---
-    class cheetah_decode_t: public kernel_decode_t {
+    template<uint_fast8_t HASH_BITS>class cheetah_decode_t: public kernel_decode_t {
     public:
+        typedef cheetah_dictionary_t<HASH_BITS> dictionary_t;
+
         DENSITY_INLINE compression_mode_t mode(void) const
         {   return compression_mode_cheetah_algorithm; }
 
@@ -94,7 +114,7 @@ namespace density {
         process_t process;
         uint_fast8_t end_data_overhead;
         main_header_parameters_t parameters;
-        cheetah_dictionary_t dictionary;
+        dictionary_t dictionary;
         uint_fast64_t reset_cycle;
 
         DENSITY_INLINE state_t exit_process(process_t process, state_t kernel_decode_state)
@@ -102,10 +122,11 @@ namespace density {
         state_t check_state(location_t *out);
         void read_signature(location_t *in);
         void process_predicted(location_t *out);
-        void process_compressed_a(const uint16_t hash, location_t *out);
-        void process_compressed_b(const uint16_t hash, location_t *out);
+        void process_compressed_a(const uint16_t stream_hash, location_t *out);
+        void process_compressed_b(const uint16_t stream_hash, location_t *out);
         void process_uncompressed(const uint32_t chunk, location_t *out);
         void kernel(location_t *in, location_t *out, const uint8_t mode);
+        bool process_run(location_t *out);
         void process_data(location_t *in, location_t *out);
     };
 #pragma pack(pop)
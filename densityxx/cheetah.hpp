@@ -25,8 +25,8 @@ namespace density {
     const uint_fast64_t cheetah_encode_process_unit_size =
         (DENSITY_BITSIZEOF(cheetah_signature_t) >> 1) * sizeof(uint32_t);
 
-    DENSITY_INLINE void
-    cheetah_encode_t::prepare_new_signature(location_t *out)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    cheetah_encode_t<HASH_BITS, STATS_T>::prepare_new_signature(location_t *out)
     {
         signatures_count++;
         shift = 0;
@@ -36,8 +36,8 @@ namespace density {
         out->pointer += sizeof(cheetah_signature_t);
         out->available_bytes -= sizeof(cheetah_signature_t);
     }
-    DENSITY_INLINE kernel_encode_t::state_t
-    cheetah_encode_t::prepare_new_block(location_t *out)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    cheetah_encode_t<HASH_BITS, STATS_T>::prepare_new_block(location_t *out)
     {
         if (cheetah_maximum_compressed_unit_size > out->available_bytes)
             return state_stall_on_output;
@@ -64,8 +64,8 @@ namespace density {
         prepare_new_signature(out);
         return state_ready;
     }
-    DENSITY_INLINE kernel_encode_t::state_t
-    cheetah_encode_t::check_state(location_t *out)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    cheetah_encode_t<HASH_BITS, STATS_T>::check_state(location_t *out)
     {
         state_t return_state;
         switch (shift) {
@@ -81,52 +81,81 @@ namespace density {
         }
         return state_ready;
     }
-    DENSITY_INLINE void
-    cheetah_encode_t::kernel(location_t *out, const uint16_t hash,
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    cheetah_encode_t<HASH_BITS, STATS_T>::kernel(location_t *out, const uint16_t hash,
                              const uint32_t chunk, const uint_fast8_t shift)
     {
         uint32_t *predicted_chunk = (uint32_t *)&dictionary.prediction_entries[last_hash];
         if (*predicted_chunk != chunk) {
-            cheetah_dictionary_t::entry_t *found = &dictionary.entries[hash];
+            typename dictionary_t::entry_t *found = &dictionary.entries[hash];
             uint32_t *found_a = &found->chunk_a;
             if (*found_a != chunk) {
                 uint32_t *found_b = &found->chunk_b;
                 if (*found_b != chunk) {
                     proximity_signature |= ((uint64_t)cheetah_signature_flag_chunk << shift);
+                    stats.cheetah(cheetah_signature_flag_chunk, 1);
                     DENSITY_MEMCPY(out->pointer, &chunk, sizeof(chunk));
                     out->pointer += sizeof(chunk);
                 } else {
                     proximity_signature |= ((uint64_t)cheetah_signature_flag_map_b << shift);
+                    stats.cheetah(cheetah_signature_flag_map_b, 1);
                     DENSITY_MEMCPY(out->pointer, &hash, sizeof(hash));
                     out->pointer += sizeof(hash);
                 }
                 *found_b = *found_a;
                 *found_a = chunk;
+                dictionary.touch(hash);
             } else {
                 proximity_signature |= ((uint64_t)cheetah_signature_flag_map_a << shift);
+                stats.cheetah(cheetah_signature_flag_map_a, 1);
                 DENSITY_MEMCPY(out->pointer, &hash, sizeof(hash));
                 out->pointer += sizeof(hash);
             }
             *predicted_chunk = chunk;
-        }
+            dictionary.touch(last_hash);
+        } else stats.cheetah(cheetah_signature_flag_predicted, 1);
         last_hash = hash;
     }
-    DENSITY_INLINE void
-    cheetah_encode_t::process_unit(location_t *in, location_t *out)
+    // A run is predicted by itself after its first chunk or two, the others are left with
+    // the predicted flag (0) and no output.
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    cheetah_encode_t<HASH_BITS, STATS_T>::process_run(location_t *in, location_t *out)
+    {
+        uint32_t chunk;
+        DENSITY_MEMCPY(&chunk, in->pointer, sizeof(chunk));
+        const uint16_t hash = hash_algorithm<HASH_BITS>(chunk);
+        uint_fast8_t count = 0;
+        for (; count < DENSITY_BITSIZEOF(cheetah_signature_t) &&
+                 (last_hash != hash ||
+                  dictionary.prediction_entries[hash].next_chunk_prediction != chunk);
+             count += 2)
+            kernel(out, hash, chunk, count);
+        stats.cheetah(cheetah_signature_flag_predicted,
+                      (DENSITY_BITSIZEOF(cheetah_signature_t) - count) >> 1);
+        in->pointer += cheetah_encode_process_unit_size;
+        shift = DENSITY_BITSIZEOF(cheetah_signature_t);
+    }
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    cheetah_encode_t<HASH_BITS, STATS_T>::process_unit(location_t *in, location_t *out)
     {
         uint32_t chunk;
         uint_fast8_t count = 0;
+        if (DENSITY_UNLIKELY(kernel_run(in->pointer, cheetah_encode_process_unit_size,
+                                        sizeof(chunk)))) {
+            process_run(in, out);
+            return;
+        }
 #ifdef __clang__
         for(; count < DENSITY_BITSIZEOF(cheetah_signature_t); count += 2) {
             DENSITY_MEMCPY(&chunk, in->pointer, sizeof(chunk));
-            kernel(out, hash_algorithm(chunk), chunk, count);
+            kernel(out, hash_algorithm<HASH_BITS>(chunk), chunk, count);
             in->pointer += sizeof(uint32_t);
         }
 #else
         for (uint_fast8_t count_b = 0; count_b < 16; count_b++) {
             DENSITY_UNROLL_2                                            \
                 (DENSITY_MEMCPY(&chunk, in->pointer, sizeof(chunk));    \
-                 kernel(out, hash_algorithm(chunk), chunk, count);      \
+                 kernel(out, hash_algorithm<HASH_BITS>(chunk), chunk, count);      \
                  in->pointer += sizeof(chunk);                          \
                  count += 2);
         }
@@ -134,8 +163,8 @@ namespace density {
         shift = DENSITY_BITSIZEOF(cheetah_signature_t);
     }
 
-    DENSITY_INLINE kernel_encode_t::state_t
-    cheetah_encode_t::init(void)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    cheetah_encode_t<HASH_BITS, STATS_T>::init(void)
     {
         signatures_count = 0;
         efficiency_checked = 0;
@@ -146,8 +175,8 @@ namespace density {
         last_hash = 0;
         return exit_process(process_prepare_new_block, state_ready);
     }
-    DENSITY_INLINE kernel_encode_t::state_t
-    cheetah_encode_t::continue_(teleport_t *in, location_t *out)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    cheetah_encode_t<HASH_BITS, STATS_T>::continue_(teleport_t *in, location_t *out)
     {
         state_t return_state;
         uint8_t *pointer_out_before;
@@ -179,8 +208,8 @@ namespace density {
         // New loop
         goto check_signature_state;
     }
-    DENSITY_INLINE kernel_encode_t::state_t
-    cheetah_encode_t::finish(teleport_t *in, location_t *out)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    cheetah_encode_t<HASH_BITS, STATS_T>::finish(teleport_t *in, location_t *out)
     {
         state_t return_state;
         uint8_t *pointer_out_before;
@@ -215,7 +244,7 @@ namespace density {
                (read_memory_location = in->read(sizeof(uint32_t)))) {
             uint32_t chunk;
             DENSITY_MEMCPY(&chunk, read_memory_location->pointer, sizeof(uint32_t));
-            kernel(out, hash_algorithm(LITTLE_ENDIAN_32(chunk)), chunk, shift);
+            kernel(out, hash_algorithm<HASH_BITS>(LITTLE_ENDIAN_32(chunk)), chunk, shift);
             shift += 2;
             read_memory_location->pointer += sizeof(chunk);
             read_memory_location->available_bytes -= sizeof(chunk);
@@ -234,8 +263,8 @@ namespace density {
     }
 
     // decode.
-    DENSITY_INLINE kernel_decode_t::state_t
-    cheetah_decode_t::check_state(location_t *out)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    cheetah_decode_t<HASH_BITS>::check_state(location_t *out)
     {
         if (out->available_bytes < cheetah_decompressed_unit_size)
             return state_stall_on_output;
@@ -262,56 +291,65 @@ namespace density {
         }
         return state_ready;
     }
-    DENSITY_INLINE void
-    cheetah_decode_t::read_signature(location_t *in)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    cheetah_decode_t<HASH_BITS>::read_signature(location_t *in)
     {
         DENSITY_MEMCPY(&signature, in->pointer, sizeof(signature));
         in->pointer += sizeof(signature);
         shift = 0;
         signatures_count++;
     }
-    DENSITY_INLINE void
-    cheetah_decode_t::process_predicted(location_t *out)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    cheetah_decode_t<HASH_BITS>::process_predicted(location_t *out)
     {
         const uint32_t chunk = dictionary.prediction_entries[last_hash].next_chunk_prediction;
         DENSITY_MEMCPY(out->pointer, &chunk, sizeof(chunk));
-        last_hash = hash_algorithm(chunk);
+        last_hash = hash_algorithm<HASH_BITS>(chunk);
     }
-    DENSITY_INLINE void
-    cheetah_decode_t::process_compressed_a(const uint16_t hash, location_t *out)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    cheetah_decode_t<HASH_BITS>::process_compressed_a(const uint16_t stream_hash,
+                                                      location_t *out)
     {
+        const uint16_t hash = hash_mask<HASH_BITS>(stream_hash);
         __builtin_prefetch(&dictionary.prediction_entries[hash]);
         const uint32_t chunk = dictionary.entries[hash].chunk_a;
         DENSITY_MEMCPY(out->pointer, &chunk, sizeof(chunk));
         dictionary.prediction_entries[last_hash].next_chunk_prediction = chunk;
+        dictionary.touch(last_hash);
         last_hash = hash;
     }
-    DENSITY_INLINE void
-    cheetah_decode_t::process_compressed_b(const uint16_t hash, location_t *out)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    cheetah_decode_t<HASH_BITS>::process_compressed_b(const uint16_t stream_hash,
+                                                      location_t *out)
     {
+        const uint16_t hash = hash_mask<HASH_BITS>(stream_hash);
         __builtin_prefetch(&dictionary.prediction_entries[hash]);
-        cheetah_dictionary_t::entry_t *const entry = &dictionary.entries[hash];
+        typename dictionary_t::entry_t *const entry = &dictionary.entries[hash];
         const uint32_t chunk = entry->chunk_b;
         entry->chunk_b = entry->chunk_a;
         entry->chunk_a = chunk;
         DENSITY_MEMCPY(out->pointer, &chunk, sizeof(chunk));
         dictionary.prediction_entries[last_hash].next_chunk_prediction = chunk;
+        dictionary.touch(hash);
+        dictionary.touch(last_hash);
         last_hash = hash;
     }
-    DENSITY_INLINE void
-    cheetah_decode_t::process_uncompressed(const uint32_t chunk, location_t *out)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    cheetah_decode_t<HASH_BITS>::process_uncompressed(const uint32_t chunk, location_t *out)
     {
-        const uint16_t hash = hash_algorithm(chunk);
+        const uint16_t hash = hash_algorithm<HASH_BITS>(chunk);
         __builtin_prefetch(&dictionary.prediction_entries[hash]);
-        cheetah_dictionary_t::entry_t *const entry = &dictionary.entries[hash];
+        typename dictionary_t::entry_t *const entry = &dictionary.entries[hash];
         entry->chunk_b = entry->chunk_a;
         entry->chunk_a = chunk;
         DENSITY_MEMCPY(out->pointer, &chunk, sizeof(chunk));
         dictionary.prediction_entries[last_hash].next_chunk_prediction = chunk;
+        dictionary.touch(hash);
+        dictionary.touch(last_hash);
         last_hash = hash;
     }
-    DENSITY_INLINE void
-    cheetah_decode_t::kernel(location_t *in, location_t *out, const uint8_t mode)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    cheetah_decode_t<HASH_BITS>::kernel(location_t *in, location_t *out, const uint8_t mode)
     {
         uint16_t hash;
         uint32_t chunk;
@@ -338,9 +376,24 @@ namespace density {
         }
         out->pointer += sizeof(uint32_t);
     }
-    DENSITY_INLINE void
-    cheetah_decode_t::process_data(location_t *in, location_t *out)
+    // A unit of predicted chunks is a run once the chunk predicted predicts itself.
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE bool
+    cheetah_decode_t<HASH_BITS>::process_run(location_t *out)
+    {
+        if (DENSITY_LIKELY(signature)) return false;
+        const uint32_t chunk = dictionary.prediction_entries[last_hash].next_chunk_prediction;
+        const uint16_t hash = hash_algorithm<HASH_BITS>(chunk);
+        if (dictionary.prediction_entries[hash].next_chunk_prediction != chunk) return false;
+        kernel_fill(out->pointer, chunk, DENSITY_BITSIZEOF(cheetah_signature_t) >> 1);
+        out->pointer += cheetah_decompressed_unit_size;
+        last_hash = hash;
+        shift = DENSITY_BITSIZEOF(cheetah_signature_t);
+        return true;
+    }
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    cheetah_decode_t<HASH_BITS>::process_data(location_t *in, location_t *out)
     {
+        if (DENSITY_UNLIKELY(process_run(out))) return;
 #ifdef __clang__
         uint_fast8_t count = 0;
         for (uint_fast8_t count_b = 0; count_b < 8; count_b ++) {
@@ -355,8 +408,8 @@ namespace density {
         shift = DENSITY_BITSIZEOF(cheetah_signature_t);
     }
 
-    DENSITY_INLINE kernel_decode_t::state_t
-    cheetah_decode_t::init(const main_header_parameters_t parameters,
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    cheetah_decode_t<HASH_BITS>::init(const main_header_parameters_t parameters,
                            const uint_fast8_t end_data_overhead)
     {
         signatures_count = 0;
@@ -370,8 +423,8 @@ namespace density {
         last_hash = 0;
         return exit_process(process_check_signature_state, state_ready);
     }
-    DENSITY_INLINE kernel_decode_t::state_t
-    cheetah_decode_t::continue_(teleport_t *in, location_t *out)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    cheetah_decode_t<HASH_BITS>::continue_(teleport_t *in, location_t *out)
     {
         state_t return_state;
         location_t *read_memory_location;
@@ -401,8 +454,8 @@ namespace density {
         // New loop
         goto check_signature_state;
     }
-    DENSITY_INLINE kernel_decode_t::state_t
-    cheetah_decode_t::finish(teleport_t *in, location_t *out)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    cheetah_decode_t<HASH_BITS>::finish(teleport_t *in, location_t *out)
     {
         state_t return_state;
         location_t *read_memory_location;
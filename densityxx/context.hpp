@@ -19,8 +19,19 @@ namespace density {
         location_t out;
         main_header_t header;
         main_footer_t footer;
+        // Hash the blocks integrity on a helper thread.
+        bool integrity_helper;
+        // Kernels picked by compression_mode_auto and compression_mode_adaptive run at this
+        // many MB/s at least, 0 for no minimum.
+        double minimum_speed;
+        // Filter of the input and log2 of its element size, only taken into account by the
+        // in-memory API.
+        filter_t filter;
+        uint_fast8_t filter_element_shift;
 
-        DENSITY_INLINE context_t(void): in(memory_teleport_buffer_size), out() {}
+        DENSITY_INLINE context_t(void):
+            in(memory_teleport_buffer_size), out(), integrity_helper(false),
+            minimum_speed(0), filter(filter_none), filter_element_shift(0) {}
 
         DENSITY_INLINE const uint_fast64_t get_total_read(void) const { return total_read; }
         DENSITY_INLINE const uint_fast64_t get_total_written(void) const { return total_written; }
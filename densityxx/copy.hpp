@@ -11,6 +11,9 @@ namespace density {
         DENSITY_INLINE state_t continue_(teleport_t *in, location_t *out)
         {   return state_ready; }
         DENSITY_INLINE state_t finish(teleport_t *in, location_t *out) { return state_ready; }
+        // Only the blocks are counted, the cost is not worth a policy.
+        DENSITY_INLINE void set_stats(stats_t *counters) { stats.attach(counters); }
+        stats_on_t stats;
     };
     class copy_decode_t: public kernel_decode_t {
     public:
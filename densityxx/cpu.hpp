@@ -0,0 +1,64 @@
+// see LICENSE.md for license.
+#pragma once
+
+#include "densityxx/globals.hpp"
+#if DENSITY_X86_SIMD == DENSITY_YES
+#include <immintrin.h>
+// Functions using an extension are compiled for it alone, they cannot be inlined in
+// generic code.
+#define DENSITY_TARGET(EXTENSION) __attribute__((target(EXTENSION)))
+#endif
+
+namespace density {
+    typedef enum {
+        cpu_simd_none = 0,
+        cpu_simd_sse41,
+        cpu_simd_avx2,
+    } cpu_simd_t;
+
+    static cpu_simd_t cpu_simd_probe(void)
+    {
+#if DENSITY_X86_SIMD == DENSITY_YES
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return cpu_simd_avx2;
+        if (__builtin_cpu_supports("sse4.1")) return cpu_simd_sse41;
+#endif
+        return cpu_simd_none;
+    }
+    static bool cpu_bmi2_probe(void)
+    {
+#if DENSITY_X86_SIMD == DENSITY_YES
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2");
+#else
+        return false;
+#endif
+    }
+    static bool cpu_sse42_probe(void)
+    {
+#if DENSITY_X86_SIMD == DENSITY_YES
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2");
+#else
+        return false;
+#endif
+    }
+    // Best SIMD extension of the running processor, probed once.
+    DENSITY_INLINE cpu_simd_t cpu_simd(void)
+    {
+        static const cpu_simd_t simd = cpu_simd_probe();
+        return simd;
+    }
+    // Whether the running processor has the BMI1/BMI2 bit manipulations, probed once.
+    DENSITY_INLINE bool cpu_bmi2(void)
+    {
+        static const bool bmi2 = cpu_bmi2_probe();
+        return bmi2;
+    }
+    // Whether the running processor has the SSE4.2 crc32 instruction, probed once.
+    DENSITY_INLINE bool cpu_sse42(void)
+    {
+        static const bool sse42 = cpu_sse42_probe();
+        return sse42;
+    }
+}
@@ -0,0 +1,17 @@
+// see LICENSE.md for license.
+#pragma once
+
+#include "densityxx/cpu.hpp"
+
+namespace density {
+    // CRC-32C (Castagnoli), a hardware instruction since SSE4.2.
+    class crc32c_context_t {
+    private:
+        uint32_t m_crc;
+        bool m_sse42;
+    public:
+        void init(void);
+        void update(const void *message, size_t length);
+        void final(uint64_t *hash1, uint64_t *hash2);
+    };
+}
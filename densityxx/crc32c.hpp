@@ -0,0 +1,78 @@
+// see LICENSE.md for license.
+#pragma once
+#include "densityxx/crc32c.def.hpp"
+
+namespace density {
+    const uint32_t crc32c_polynomial = 0x82f63b78;  // Reversed 0x1edc6f41
+
+    typedef struct {
+        uint32_t entries[256];
+    } crc32c_table_t;
+    static crc32c_table_t crc32c_table_build(void)
+    {
+        crc32c_table_t table;
+        for (uint32_t idx = 0; idx < 256; ++idx) {
+            uint32_t crc = idx;
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ (crc32c_polynomial & (0 - (crc & 1)));
+            table.entries[idx] = crc;
+        }
+        return table;
+    }
+    static DENSITY_INLINE uint32_t
+    crc32c_update_table(uint32_t crc, const uint8_t *message, size_t length)
+    {
+        static const crc32c_table_t table = crc32c_table_build();
+        while (length--) crc = table.entries[(crc ^ *message++) & 0xff] ^ (crc >> 8);
+        return crc;
+    }
+#if DENSITY_X86_SIMD == DENSITY_YES
+    static DENSITY_TARGET("sse4.2") uint32_t
+    crc32c_update_sse42(uint32_t crc, const uint8_t *message, size_t length)
+    {
+#if defined(__x86_64__)
+        uint64_t crc64 = crc;
+        for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t)) {
+            uint64_t value;
+            DENSITY_MEMCPY(&value, message, sizeof(value));
+            crc64 = _mm_crc32_u64(crc64, value);
+            message += sizeof(value);
+        }
+        crc = (uint32_t)crc64;
+#endif
+        for (; length >= sizeof(uint32_t); length -= sizeof(uint32_t)) {
+            uint32_t value;
+            DENSITY_MEMCPY(&value, message, sizeof(value));
+            crc = _mm_crc32_u32(crc, value);
+            message += sizeof(value);
+        }
+        while (length--) crc = _mm_crc32_u8(crc, *message++);
+        return crc;
+    }
+#endif
+
+    DENSITY_INLINE void
+    crc32c_context_t::init(void)
+    {
+        m_crc = 0xffffffff;
+        m_sse42 = cpu_sse42();
+    }
+    DENSITY_INLINE void
+    crc32c_context_t::update(const void *message, size_t length)
+    {
+#if DENSITY_X86_SIMD == DENSITY_YES
+        if (m_sse42) {
+            m_crc = crc32c_update_sse42(m_crc, (const uint8_t *)message, length);
+            return;
+        }
+#endif
+        m_crc = crc32c_update_table(m_crc, (const uint8_t *)message, length);
+    }
+    // The footer keeps its two hashsums, the second one is left zero.
+    DENSITY_INLINE void
+    crc32c_context_t::final(uint64_t *hash1, uint64_t *hash2)
+    {
+        *hash1 = m_crc ^ 0xffffffff;
+        *hash2 = 0;
+    }
+}
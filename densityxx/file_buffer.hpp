@@ -2,36 +2,131 @@
 #pragma once
 
 #include "densityxx/context.hpp"
+#include "densityxx/parallel.hpp"
 
 namespace density {
+    // Buffers handed over in order between a producer and a consumer thread, the producer
+    // fills the free ones and the consumer empties the full ones. Once stopped, the
+    // producer gets no more buffers and the consumer gets the full ones left.
+    template<unsigned size, unsigned count>class buffer_ring_t {
+    public:
+        struct slot_t {
+            uint8_t data[size];
+            uint_fast64_t bytes;
+            bool last, error;
+        };
+
+        DENSITY_INLINE buffer_ring_t(void): filled(0), emptied(0), stopping(false) {}
+
+        DENSITY_INLINE slot_t *acquire_free(void)
+        {   std::unique_lock<std::mutex> lock(mutex);
+            while (filled - emptied == count && !stopping) changed.wait(lock);
+            return stopping ? NULL: &slots[filled % count]; }
+        DENSITY_INLINE void publish(void)
+        {   std::lock_guard<std::mutex> lock(mutex);
+            ++filled;
+            changed.notify_all(); }
+        DENSITY_INLINE slot_t *acquire_full(void)
+        {   std::unique_lock<std::mutex> lock(mutex);
+            while (filled == emptied && !stopping) changed.wait(lock);
+            return filled == emptied ? NULL: &slots[emptied % count]; }
+        DENSITY_INLINE void release(void)
+        {   std::lock_guard<std::mutex> lock(mutex);
+            ++emptied;
+            changed.notify_all(); }
+        DENSITY_INLINE void wait_empty(void)
+        {   std::unique_lock<std::mutex> lock(mutex);
+            while (filled != emptied) changed.wait(lock); }
+        DENSITY_INLINE void stop(void)
+        {   std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            changed.notify_all(); }
+    private:
+        slot_t slots[count];
+        uint_fast64_t filled, emptied;
+        bool stopping;
+        std::mutex mutex;
+        std::condition_variable changed;
+    };
+
+    // Reads ahead and writes behind on threads of their own, so the file I/O overlaps with
+    // the kernels, the buffers given to the context are cycled through a ring of slots.
+    // With a single hardware thread the slots are read and written in place instead.
+    const unsigned file_buffer_slots = 4;
     template<unsigned in_size, unsigned out_size>class file_buffer_t {
     private:
+        typedef buffer_ring_t<in_size, file_buffer_slots> in_ring_t;
+        typedef buffer_ring_t<out_size, file_buffer_slots> out_ring_t;
+
         bool last_read;
         FILE *rfp, *wfp;
-        uint8_t in[in_size], out[out_size];
+        in_ring_t in;
+        out_ring_t out;
+        typename in_ring_t::slot_t *in_slot;
+        typename out_ring_t::slot_t *out_slot;
+        std::atomic<bool> error_on_output;
+        const bool threaded;
+        std::thread reader, writer;
+
+        DENSITY_INLINE bool read_slot(void)
+        {   typename in_ring_t::slot_t *slot = in.acquire_free();
+            if (!slot) return false;
+            slot->bytes = (uint_fast64_t)fread(slot->data, 1, sizeof(slot->data), rfp);
+            const bool last = slot->last = slot->bytes < sizeof(slot->data);
+            slot->error = last && ferror(rfp);
+            in.publish();
+            return !last; }
+        DENSITY_INLINE bool write_slot(void)
+        {   typename out_ring_t::slot_t *slot = out.acquire_full();
+            if (!slot) return false;
+            if ((uint_fast64_t)fwrite(slot->data, 1, slot->bytes, wfp) < slot->bytes &&
+                ferror(wfp)) error_on_output = true;
+            out.release();
+            return true; }
+        void read_ahead(void) { while (read_slot()); }
+        void write_behind(void) { while (write_slot()); }
 
+        // The context does not hold on to the input and output it has stalled on.
         DENSITY_INLINE buffer_state_t do_input(context_t &context)
-        {   uint_fast64_t read = (uint_fast64_t)fread(in, 1, sizeof(in), rfp);
-            context.update_input(in, read);
-            if (!(last_read = (read < sizeof(in)))) return buffer_state_ready;
-            return ferror(rfp) ? buffer_state_error_on_input: buffer_state_ready; }
+        {   if (last_read) {
+                context.update_input(in_slot->data, 0);
+                return buffer_state_ready;
+            }
+            if (in_slot) in.release();
+            if (!threaded) read_slot();
+            in_slot = in.acquire_full();
+            context.update_input(in_slot->data, in_slot->bytes);
+            last_read = in_slot->last;
+            return in_slot->error ? buffer_state_error_on_input: buffer_state_ready; }
         DENSITY_INLINE buffer_state_t do_output(context_t &context)
-        {   uint_fast64_t available = context.output_available_for_use();
-            uint_fast64_t written = (uint_fast64_t)fwrite(out, 1, available, wfp);
-            if (written < available && ferror(wfp)) return buffer_state_error_on_output;
-            context.update_output(out, sizeof(out));
-            return buffer_state_ready; }
+        {   out_slot->bytes = context.output_available_for_use();
+            out.publish();
+            if (!threaded) write_slot();
+            out_slot = out.acquire_free();
+            context.update_output(out_slot->data, sizeof(out_slot->data));
+            return error_on_output ? buffer_state_error_on_output: buffer_state_ready; }
     public:
-        DENSITY_INLINE file_buffer_t(FILE *rfp, FILE *wfp): rfp(rfp), wfp(wfp) {}
-        DENSITY_INLINE ~file_buffer_t() {}
+        DENSITY_INLINE file_buffer_t(FILE *rfp, FILE *wfp):
+            last_read(false), rfp(rfp), wfp(wfp), in_slot(NULL), out_slot(NULL),
+            error_on_output(false), threaded(parallel_threads(0) > 1)
+        {   if (!threaded) return;
+            reader = std::thread(&file_buffer_t::read_ahead, this);
+            writer = std::thread(&file_buffer_t::write_behind, this); }
+        DENSITY_INLINE ~file_buffer_t()
+        {   in.stop();
+            out.stop();
+            if (reader.joinable()) reader.join();
+            if (writer.joinable()) writer.join(); }
 
-        DENSITY_INLINE size_t get_in_size(void) const { return sizeof(in); }
-        DENSITY_INLINE size_t get_out_size(void) const { return sizeof(out); }
+        DENSITY_INLINE size_t get_in_size(void) const { return in_size; }
+        DENSITY_INLINE size_t get_out_size(void) const { return out_size; }
         DENSITY_INLINE bool get_last_read(void) const { return last_read; }
 
         DENSITY_INLINE void init(const compression_mode_t compression_mode,
                          const block_type_t block_type, context_t &context)
-        {   context.init(compression_mode, block_type, in, sizeof(in), out, sizeof(out)); }
+        {   out_slot = out.acquire_free();
+            context.init(compression_mode, block_type, NULL, 0,
+                         out_slot->data, sizeof(out_slot->data)); }
         DENSITY_INLINE buffer_state_t
         action(encode_state_t encode_state, context_t &context)
         {   switch (encode_state) {
@@ -44,5 +139,9 @@ namespace density {
             case decode_state_stall_on_input: return do_input(context);
             case decode_state_stall_on_output: return do_output(context);
             default: return buffer_state_error; } }
+        // Waits for the output handed over so far to be written.
+        DENSITY_INLINE buffer_state_t flush(void)
+        {   out.wait_empty();
+            return error_on_output ? buffer_state_error_on_output: buffer_state_ready; }
     };
 }
@@ -0,0 +1,145 @@
+// see LICENSE.md for license.
+#pragma once
+
+#include <algorithm>
+#include "densityxx/globals.hpp"
+
+namespace density {
+    // The input is filtered by windows of filter_window bytes, small enough for the bytes
+    // a shuffle spreads across a window to stay in cache. The bytes past the last whole
+    // element of a window are left as they are.
+    const uint_fast64_t filter_window = 1 << 16;
+
+    // Elements are little endian in the filtered data, whatever the host.
+    static DENSITY_INLINE uint16_t filter_little_endian(const uint16_t element)
+    {   return LITTLE_ENDIAN_16(element); }
+    static DENSITY_INLINE uint32_t filter_little_endian(const uint32_t element)
+    {   return LITTLE_ENDIAN_32(element); }
+    static DENSITY_INLINE uint64_t filter_little_endian(const uint64_t element)
+    {   return LITTLE_ENDIAN_64(element); }
+    template<class ELEMENT_T>static DENSITY_INLINE ELEMENT_T
+    filter_load(const uint8_t *pointer)
+    {   ELEMENT_T element;
+        DENSITY_MEMCPY(&element, pointer, sizeof(element));
+        return filter_little_endian(element); }
+    template<class ELEMENT_T>static DENSITY_INLINE void
+    filter_store(uint8_t *pointer, const ELEMENT_T element)
+    {   const ELEMENT_T little_endian = filter_little_endian(element);
+        DENSITY_MEMCPY(pointer, &little_endian, sizeof(little_endian)); }
+
+    // Every element is replaced by its difference to the previous one, slowly varying
+    // counters and timestamps become runs of small values.
+    template<class ELEMENT_T>static DENSITY_INLINE void
+    filter_delta_encode(const uint8_t *in, uint8_t *out, const uint_fast64_t size,
+                        ELEMENT_T previous)
+    {
+        const uint_fast64_t elements = size / sizeof(ELEMENT_T);
+        for (uint_fast64_t idx = 0; idx < elements; ++idx) {
+            const ELEMENT_T element = filter_load<ELEMENT_T>(in + idx * sizeof(ELEMENT_T));
+            filter_store<ELEMENT_T>(out + idx * sizeof(ELEMENT_T), element - previous);
+            previous = element;
+        }
+        if (in != out) DENSITY_MEMCPY(out + elements * sizeof(ELEMENT_T),
+                                      in + elements * sizeof(ELEMENT_T),
+                                      size - elements * sizeof(ELEMENT_T));
+    }
+    template<class ELEMENT_T>static DENSITY_INLINE void
+    filter_delta_decode(uint8_t *data, const uint_fast64_t size, ELEMENT_T previous)
+    {
+        const uint_fast64_t elements = size / sizeof(ELEMENT_T);
+        for (uint_fast64_t idx = 0; idx < elements; ++idx) {
+            previous += filter_load<ELEMENT_T>(data + idx * sizeof(ELEMENT_T));
+            filter_store<ELEMENT_T>(data + idx * sizeof(ELEMENT_T), previous);
+        }
+    }
+
+    // The bytes of the same rank in the elements are grouped together, the high bytes of
+    // numbers of a similar magnitude (exponents, upper digits) then repeat.
+    template<class ELEMENT_T>static DENSITY_INLINE void
+    filter_shuffle_encode(const uint8_t *in, uint8_t *out, const uint_fast64_t size)
+    {
+        const uint_fast64_t elements = size / sizeof(ELEMENT_T);
+        for (uint_fast64_t idx = 0; idx < elements; ++idx)
+            for (uint_fast8_t rank = 0; rank < sizeof(ELEMENT_T); ++rank)
+                out[rank * elements + idx] = in[idx * sizeof(ELEMENT_T) + rank];
+        DENSITY_MEMCPY(out + elements * sizeof(ELEMENT_T), in + elements * sizeof(ELEMENT_T),
+                       size - elements * sizeof(ELEMENT_T));
+    }
+    template<class ELEMENT_T>static DENSITY_INLINE void
+    filter_shuffle_decode(const uint8_t *in, uint8_t *out, const uint_fast64_t size)
+    {
+        const uint_fast64_t elements = size / sizeof(ELEMENT_T);
+        for (uint_fast64_t idx = 0; idx < elements; ++idx)
+            for (uint_fast8_t rank = 0; rank < sizeof(ELEMENT_T); ++rank)
+                out[idx * sizeof(ELEMENT_T) + rank] = in[rank * elements + idx];
+        DENSITY_MEMCPY(out + elements * sizeof(ELEMENT_T), in + elements * sizeof(ELEMENT_T),
+                       size - elements * sizeof(ELEMENT_T));
+    }
+
+    // The delta is taken first, the shuffle then groups the bytes of the differences.
+    template<class ELEMENT_T>static DENSITY_INLINE void
+    filter_encode(const uint8_t *in, uint8_t *out, const uint_fast64_t size,
+                  const filter_t filter)
+    {
+        uint8_t window[filter_window];
+        for (uint_fast64_t offset = 0; offset < size; offset += filter_window) {
+            const uint_fast64_t length = std::min(filter_window, size - offset);
+            const ELEMENT_T previous = offset ?
+                filter_load<ELEMENT_T>(in + offset - sizeof(ELEMENT_T)): 0;
+            switch (filter) {
+            case filter_shuffle:
+                filter_shuffle_encode<ELEMENT_T>(in + offset, out + offset, length);
+                break;
+            case filter_delta:
+                filter_delta_encode<ELEMENT_T>(in + offset, out + offset, length, previous);
+                break;
+            case filter_shuffle_delta:
+                filter_delta_encode<ELEMENT_T>(in + offset, window, length, previous);
+                filter_shuffle_encode<ELEMENT_T>(window, out + offset, length);
+                break;
+            default: DENSITY_MEMCPY(out + offset, in + offset, length);
+            }
+        }
+    }
+    template<class ELEMENT_T>static DENSITY_INLINE void
+    filter_decode(uint8_t *data, const uint_fast64_t size, const filter_t filter)
+    {
+        uint8_t window[filter_window];
+        for (uint_fast64_t offset = 0; offset < size; offset += filter_window) {
+            const uint_fast64_t length = std::min(filter_window, size - offset);
+            if (filter & filter_shuffle) {
+                DENSITY_MEMCPY(window, data + offset, length);
+                filter_shuffle_decode<ELEMENT_T>(window, data + offset, length);
+            }
+            // The previous element is already restored.
+            if (filter & filter_delta)
+                filter_delta_decode<ELEMENT_T>(data + offset, length, offset ?
+                                               filter_load<ELEMENT_T>(data + offset -
+                                                                      sizeof(ELEMENT_T)): 0);
+        }
+    }
+
+    // element_shift is log2 of the element size, 1 to 3.
+    static DENSITY_INLINE bool
+    filter_encode(const uint8_t *in, uint8_t *out, const uint_fast64_t size,
+                  const filter_t filter, const uint_fast8_t element_shift)
+    {
+        switch (element_shift) {
+        case 1: filter_encode<uint16_t>(in, out, size, filter); return true;
+        case 2: filter_encode<uint32_t>(in, out, size, filter); return true;
+        case 3: filter_encode<uint64_t>(in, out, size, filter); return true;
+        default: return false;
+        }
+    }
+    static DENSITY_INLINE bool
+    filter_decode(uint8_t *data, const uint_fast64_t size,
+                  const filter_t filter, const uint_fast8_t element_shift)
+    {
+        switch (element_shift) {
+        case 1: filter_decode<uint16_t>(data, size, filter); return true;
+        case 2: filter_decode<uint32_t>(data, size, filter); return true;
+        case 3: filter_decode<uint64_t>(data, size, filter); return true;
+        default: return false;
+        }
+    }
+}
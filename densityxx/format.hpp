@@ -65,6 +65,12 @@ namespace density {
             uint8_t as_bytes[8];
         };
     };
+    typedef enum {
+        main_header_flag_index = 0x1,  // A seek index precedes the main footer.
+        main_header_flag_content_size = 0x2,  // The decompressed size is recorded.
+        main_header_flag_shuffle = 0x4,  // The input was shuffled before the kernel.
+        main_header_flag_delta = 0x8,  // The input was delta encoded before the kernel.
+    } main_header_flag_t;
     class main_header_t {
     private:
         uint8_t _version[3];
@@ -79,6 +85,48 @@ namespace density {
         {   return (const block_type_t)_block_type; }
         DENSITY_INLINE const main_header_parameters_t &parameters(void) const
         {   return _parameters; }
+        // 0 for a plain stream, log2 of the segment size for a segmented stream.
+        DENSITY_INLINE const uint_fast8_t segment_shift(void) const
+        {   return _parameters.as_bytes[1]; }
+        DENSITY_INLINE void set_segment_shift(const uint_fast8_t segment_shift)
+        {   _parameters.as_bytes[1] = segment_shift; }
+        // Dictionary hash width, 0 in streams written before it was recorded.
+        DENSITY_INLINE const uint_fast8_t hash_bits(void) const
+        {   return _parameters.as_bytes[3] ? _parameters.as_bytes[3]: hash_default_bits; }
+        DENSITY_INLINE void set_hash_bits(const uint_fast8_t hash_bits)
+        {   _parameters.as_bytes[3] = hash_bits; }
+        // The decompressed size takes the last 4 parameters bytes and the reserved ones
+        // (56 bits), larger sizes are not recorded.
+        DENSITY_INLINE const uint_fast64_t content_size(void) const
+        {   uint_fast64_t content_size = 0;
+            for (int idx = 2; idx >= 0; --idx)
+                content_size = (content_size << 8) | _reserved[idx];
+            for (int idx = 7; idx >= 4; --idx)
+                content_size = (content_size << 8) | _parameters.as_bytes[idx];
+            return content_size; }
+        DENSITY_INLINE void set_content_size(uint_fast64_t content_size)
+        {   if (content_size >> 56) return;
+            for (int idx = 4; idx < 8; ++idx, content_size >>= 8)
+                _parameters.as_bytes[idx] = (uint8_t)content_size;
+            for (int idx = 0; idx < 3; ++idx, content_size >>= 8)
+                _reserved[idx] = (uint8_t)content_size;
+            set_flag(main_header_flag_content_size); }
+        DENSITY_INLINE const bool has_flag(const main_header_flag_t flag) const
+        {   return _parameters.as_bytes[2] & flag; }
+        DENSITY_INLINE void set_flag(const main_header_flag_t flag)
+        {   _parameters.as_bytes[2] |= flag; }
+        // Filters undone after decoding, the element size is 2^filter_element_shift()
+        // bytes, recorded in bits 4 and 5 of the flags.
+        DENSITY_INLINE const filter_t filter(void) const
+        {   return (filter_t)((has_flag(main_header_flag_shuffle) ? filter_shuffle: 0) |
+                              (has_flag(main_header_flag_delta) ? filter_delta: 0)); }
+        DENSITY_INLINE const uint_fast8_t filter_element_shift(void) const
+        {   return (_parameters.as_bytes[2] >> 4) & 0x3; }
+        DENSITY_INLINE void set_filter(const filter_t filter, const uint_fast8_t element_shift)
+        {   if (filter == filter_none) return;
+            if (filter & filter_shuffle) set_flag(main_header_flag_shuffle);
+            if (filter & filter_delta) set_flag(main_header_flag_delta);
+            _parameters.as_bytes[2] |= (element_shift & 0x3) << 4; }
 
         DENSITY_INLINE void
         setup(const compression_mode_t compression_mode, const block_type_t block_type)
@@ -93,10 +141,37 @@ namespace density {
 #if DENSITY_ENABLE_PARALLELIZABLE_DECOMPRESSIBLE_OUTPUT == DENSITY_YES
             _parameters.as_bytes[0] = dictionary_preferred_reset_cycle_shift;
 #endif
+            _parameters.as_bytes[3] = hash_default_bits;
         }
     };
 #pragma pack(pop)
 
+    // index entry.
+    typedef enum {
+        index_entry_flag_reset = 0x1,  // The dictionaries are reset at this entry.
+    } index_entry_flag_t;
+#pragma pack(push)
+#pragma pack(4)
+    // One entry per dictionary reset cycle, the last one only marks the end of the data.
+    class index_entry_t {
+    public:
+        uint64_t original_offset;
+        uint64_t compressed_offset;
+        uint32_t flags;
+        DENSITY_INLINE uint_fast32_t read(location_t *in)
+        {   in->read(this, sizeof(*this)); return sizeof(*this); }
+        DENSITY_INLINE uint_fast32_t write(location_t *out)
+        {   out->write(this, sizeof(*this)); return sizeof(*this); }
+        DENSITY_INLINE uint_fast32_t
+        write(location_t *out, const uint64_t original_offset,
+              const uint64_t compressed_offset, const uint32_t flags)
+        {   this->original_offset = original_offset;
+            this->compressed_offset = compressed_offset;
+            this->flags = flags;
+            return write(out); }
+    };
+#pragma pack(pop)
+
     // main footer.
 #pragma pack(push)
 #pragma pack(4)
@@ -104,6 +179,12 @@ namespace density {
     public:
         // Previous block's relative start position (parallelizable decompressible output)
         uint32_t relative_position; // previousBlockRelativeStartPosition;
+        DENSITY_INLINE uint_fast32_t read(location_t *in)
+        {   in->read(this, sizeof(*this)); return sizeof(*this); }
+        DENSITY_INLINE uint_fast32_t write(location_t *out)
+        {   out->write(this, sizeof(*this)); return sizeof(*this); }
+        DENSITY_INLINE uint_fast32_t write(location_t *out, const uint32_t relative_position)
+        {   this->relative_position = relative_position; return write(out); }
     };
 #pragma pack(pop)
 }
@@ -20,6 +20,16 @@
 
 #define DENSITY_ENABLE_PARALLELIZABLE_DECOMPRESSIBLE_OUTPUT  DENSITY_NO
 
+// SIMD kernels picked at run time on x86, build with DENSITY_X86_SIMD=DENSITY_NO to keep
+// the scalar ones only.
+#ifndef DENSITY_X86_SIMD
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DENSITY_X86_SIMD  DENSITY_YES
+#else
+#define DENSITY_X86_SIMD  DENSITY_NO
+#endif
+#endif
+
 #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
 #define LITTLE_ENDIAN_64(b)   ((uint64_t)b)
 #define LITTLE_ENDIAN_32(b)   ((uint32_t)b)
@@ -131,19 +141,49 @@ namespace density {
     const uint_fast64_t dictionary_preferred_reset_cycle =
         1 << dictionary_preferred_reset_cycle_shift;
 
+    // Dictionaries have 2^hash_bits entries, hashes are stored on 16 bits in the streams.
+    const uint_fast8_t hash_minimum_bits = 10;
+    const uint_fast8_t hash_default_bits = 16;
+    const uint_fast8_t hash_maximum_bits = 16;
+
+    // Parallel streams are cut into segments of 2^shift input bytes, every segment is
+    // encoded with a freshly initialized kernel (one dictionary reset cycle).
+    const uint_fast8_t segment_minimum_shift = 16;
+    const uint_fast8_t segment_automatic_minimum_shift = 20;
+    const uint_fast8_t segment_preferred_shift = 19 + dictionary_preferred_reset_cycle_shift;
+    const uint_fast8_t segment_maximum_shift = 30;
+    // Free output the decoders want before decoding a unit (the largest decoded unit).
+    const uint_fast64_t decode_output_lookahead = 1 << 8;
+
     typedef enum {
         compression_mode_copy = 0,
         compression_mode_chameleon_algorithm = 1,
         compression_mode_cheetah_algorithm = 2,
         compression_mode_lion_algorithm = 3,
+        compression_mode_auto = 4,  // Picked by sampling the input, never stored
+        compression_mode_adaptive = 5,  // Picked block by block among the three above
     } compression_mode_t;
-    DENSITY_ENUM_RENDER4(compression_mode, copy, chameleon_algorithm,
-                         cheetah_algorithm, lion_algorithm);
+    DENSITY_ENUM_RENDER6(compression_mode, copy, chameleon_algorithm,
+                         cheetah_algorithm, lion_algorithm, auto, adaptive);
     typedef enum {
         block_type_default = 0,                      // Standard, no integrity check
-        block_type_with_hashsum_integrity_check = 1  // Add data integrity check to the stream
+        block_type_with_hashsum_integrity_check = 1, // Add data integrity check to the stream
+        block_type_with_crc32c_integrity_check = 2   // Same, hashed with CRC-32C
     } block_type_t;
-    DENSITY_ENUM_RENDER2(block_type, default, with_hashsum_integrity_check);
+    DENSITY_ENUM_RENDER3(block_type, default, with_hashsum_integrity_check,
+                         with_crc32c_integrity_check);
+    // Whether the blocks end with a footer holding their integrity hashsum.
+    inline bool block_type_integrity_checked(const block_type_t block_type)
+    {   return block_type != block_type_default; }
+    // Reversible filters for arrays of 2, 4 or 8 bytes numbers, applied to the input
+    // before the kernel and undone after it.
+    typedef enum {
+        filter_none = 0,
+        filter_shuffle = 0x1,       // Bytes grouped by their rank in the elements
+        filter_delta = 0x2,         // Elements replaced by their difference to the previous
+        filter_shuffle_delta = 0x3  // Both, the delta first
+    } filter_t;
+    DENSITY_ENUM_RENDER4(filter, none, shuffle, delta, shuffle_delta);
 
     typedef enum {
         buffer_state_ready = 0,
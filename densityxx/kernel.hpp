@@ -2,12 +2,49 @@
 #pragma once
 
 #include "densityxx/format.hpp"
+#include "densityxx/stats.hpp"
 
 namespace density {
-    const size_t hash_bits = 16;
     const uint32_t hash_multiplier = 0x9D6EF916U;
-    DENSITY_INLINE uint16_t hash_algorithm(const uint32_t value32)
-    {   return (uint16_t)((value32 * hash_multiplier) >> (32 - hash_bits)); }
+    template<uint_fast8_t HASH_BITS>DENSITY_INLINE uint16_t
+    hash_algorithm(const uint32_t value32)
+    {   return (uint16_t)((value32 * hash_multiplier) >> (32 - HASH_BITS)); }
+    // Hashes read from a stream are masked, a corrupted one has to stay in the dictionary.
+    template<uint_fast8_t HASH_BITS>DENSITY_INLINE uint16_t hash_mask(const uint16_t hash)
+    {   return (uint16_t)(hash & ((1 << HASH_BITS) - 1)); }
+
+    // Runs of one value (zero pages of sparse files and images, padded records) take the
+    // same way through the kernels every time, they skip it. Whether the size bytes from
+    // pointer repeat their first width bytes:
+    static DENSITY_INLINE bool
+    kernel_run(const uint8_t *pointer, const uint_fast64_t size, const uint_fast8_t width)
+    {   return !memcmp(pointer, pointer + width, width) &&
+            !memcmp(pointer, pointer + width, size - width); }
+    // Writes count copies of chunk, two at a time.
+    static DENSITY_INLINE void
+    kernel_fill(uint8_t *pointer, const uint32_t chunk, const uint_fast64_t count)
+    {   if (!chunk) { memset(pointer, 0, count * sizeof(chunk)); return; }
+        const uint64_t pair = ((uint64_t)chunk << 32) | chunk;
+        uint_fast64_t idx = 0;
+        for (; idx + 2 <= count; idx += 2)
+            DENSITY_MEMCPY(pointer + idx * sizeof(chunk), &pair, sizeof(pair));
+        if (idx < count) DENSITY_MEMCPY(pointer + idx * sizeof(chunk), &chunk, sizeof(chunk)); }
+
+    // Dictionary slots written since the last reset, kept while they are few enough for
+    // clearing them one by one to beat wiping the whole dictionary.
+    template<uint_fast8_t HASH_BITS>class dictionary_slots_t {
+    public:
+        static const uint_fast32_t capacity = 1 << (HASH_BITS - 4);
+        uint_fast32_t count;
+        uint16_t slots[capacity + 1];
+
+        // Nothing is known about the initial content, the first reset wipes it all.
+        DENSITY_INLINE dictionary_slots_t(void): count(capacity + 1) {}
+        DENSITY_INLINE void touch(const uint16_t slot)
+        {   if (count <= capacity) slots[count++] = slot; }
+        DENSITY_INLINE const bool overflown(void) const { return count > capacity; }
+        DENSITY_INLINE void clear(void) { count = 0; }
+    };
 
     // encode.
     class kernel_encode_t {
@@ -22,6 +59,8 @@ namespace density {
         } state_t;
         DENSITY_ENUM_RENDER6(state, ready, info_new_block, info_efficiency_check,
                              stall_on_input, stall_on_output, error);
+        // Only the kernels choosing among others by their speed take it into account.
+        DENSITY_INLINE void set_minimum_speed(const double minimum_speed) {}
     };
 
     // decode.
@@ -1,6 +1,7 @@
 // see LICENSE.md for license.
 #pragma once
 #include "densityxx/kernel.hpp"
+#include "densityxx/cpu.hpp"
 
 namespace density {
     typedef uint64_t lion_signature_t;
@@ -72,7 +73,7 @@ namespace density {
     DENSITY_ENUM_RENDER2(lion_predictions_signature_flag, a, b)
 
     //-- dictionary ---
-    class lion_dictionary_t {
+    template<uint_fast8_t HASH_BITS>class lion_dictionary_t {
     public:
         typedef struct {
             uint32_t chunk_a;
@@ -87,27 +88,36 @@ namespace density {
             uint32_t next_chunk_c;
         } prediction_t;
 
-        entry_t entries[1 << hash_bits];
-        prediction_t predictions[1 << hash_bits];
-        DENSITY_INLINE void reset(void) { memset(this, 0, sizeof(*this)); }
+        entry_t entries[1 << HASH_BITS];
+        prediction_t predictions[1 << HASH_BITS];
+        dictionary_slots_t<HASH_BITS> written;
+        DENSITY_INLINE void touch(const uint16_t hash) { written.touch(hash); }
+        DENSITY_INLINE void reset(void)
+        {   if (written.overflown()) {
+                memset(entries, 0, sizeof(entries));
+                memset(predictions, 0, sizeof(predictions));
+            } else for (uint_fast32_t idx = 0; idx < written.count; ++idx) {
+                    memset(&entries[written.slots[idx]], 0, sizeof(entry_t));
+                    memset(&predictions[written.slots[idx]], 0, sizeof(prediction_t));
+                }
+            written.clear(); }
     };
 
     //--- encode ---
+    template<uint_fast8_t HASH_BITS, class STATS_T = stats_off_t>
     class lion_encode_t: public kernel_encode_t {
     public:
+        typedef lion_dictionary_t<HASH_BITS> dictionary_t;
+
         DENSITY_INLINE compression_mode_t mode(void) const
         {   return compression_mode_lion_algorithm; }
 
         state_t init(void);
         state_t continue_(teleport_t *in, location_t *out);
         state_t finish(teleport_t *in, location_t *out);
-    private:
-        typedef enum {
-            process_check_block_state,
-            process_check_output_size,
-            process_unit,
-        } process_t;
-        DENSITY_ENUM_RENDER3(process, check_block_state, check_output_size, unit);
+        DENSITY_INLINE void set_stats(stats_t *counters) { stats.attach(counters); }
+        // Also counted in by the block encoder.
+        STATS_T stats;
 
         static const size_t minimum_lookahead =
             sizeof(block_footer_t) + sizeof(block_header_t) + sizeof(block_mode_marker_t) +
@@ -115,6 +125,13 @@ namespace density {
         // On a normal cycle, lion_chunks_per_process_unit = 64 chunks = 256 bytes can be
         // compressed at once, before being in intercept mode where another 256 input bytes
         // could be processed before ending the signature.
+    private:
+        typedef enum {
+            process_check_block_state,
+            process_check_output_size,
+            process_unit,
+        } process_t;
+        DENSITY_ENUM_RENDER3(process, check_block_state, check_output_size, unit);
 
         typedef struct {
             uint8_t content[lion_maximum_compressed_body_size_per_signature];
@@ -133,10 +150,11 @@ namespace density {
         content_t transient_content;
         bool signature_intercept_mode;
         bool end_marker;
-        lion_dictionary_t dictionary;
+        dictionary_t dictionary;
 #if DENSITY_ENABLE_PARALLELIZABLE_DECOMPRESSIBLE_OUTPUT == DENSITY_YES
         uint_fast64_t reset_cycle;
 #endif
+        bool bmi2;
 
         DENSITY_INLINE state_t exit_process(process_t process, state_t kernel_encode_state)
         {   this->process = process; return kernel_encode_state; }
@@ -150,23 +168,37 @@ namespace density {
         push_code_to_signature(location_t *out, const lion_entropy_code_t code)
         {   push_to_signature(out, code.value, code.bit_length); }
         void kernel(location_t *out, const uint16_t hash, const uint32_t chunk);
+        void process_run(const uint_fast8_t chunks_per_process_unit,
+                         const uint_fast16_t process_unit_size,
+                         location_t *in, location_t *out);
         void process_unit_generic(const uint_fast8_t chunks_per_process_unit,
                                   const uint_fast16_t process_unit_size,
                                   location_t *in, location_t *out);
+#if DENSITY_X86_SIMD == DENSITY_YES
+        DENSITY_TARGET("bmi,bmi2") void
+        process_unit_generic_bmi2(const uint_fast8_t chunks_per_process_unit,
+                                  const uint_fast16_t process_unit_size,
+                                  location_t *in, location_t *out);
+#endif
+        void process_unit_dispatch(const uint_fast8_t chunks_per_process_unit,
+                                   const uint_fast16_t process_unit_size,
+                                   location_t *in, location_t *out);
         DENSITY_INLINE void
         process_unit_small(location_t *in, location_t *out)
-        {   process_unit_generic(lion_chunks_per_process_unit_small,
-                                 lion_process_unit_size_small, in, out); }
+        {   process_unit_dispatch(lion_chunks_per_process_unit_small,
+                                  lion_process_unit_size_small, in, out); }
         DENSITY_INLINE void
         process_unit_big(location_t *in, location_t *out)
-        {   process_unit_generic(lion_chunks_per_process_unit_big,
-                                 lion_process_unit_size_big, in, out); }
+        {   process_unit_dispatch(lion_chunks_per_process_unit_big,
+                                  lion_process_unit_size_big, in, out); }
         void process_step_unit(location_t *in, location_t *out);
     };
 
     //--- decode ---
-    class lion_decode_t: public kernel_decode_t {
+    template<uint_fast8_t HASH_BITS>class lion_decode_t: public kernel_decode_t {
     public:
+        typedef lion_dictionary_t<HASH_BITS> dictionary_t;
+
         DENSITY_INLINE compression_mode_t mode(void) const
         {   return compression_mode_lion_algorithm; }
 
@@ -199,8 +231,9 @@ namespace density {
         process_t process;
         uint_fast8_t end_data_overhead;
         main_header_parameters_t parameters;
-        lion_dictionary_t dictionary;
+        dictionary_t dictionary;
         uint_fast64_t reset_cycle;
+        bool bmi2;
 
         DENSITY_INLINE state_t exit_process(process_t process, state_t kernel_decode_state)
         {   this->process = process; return kernel_decode_state; }
@@ -209,24 +242,26 @@ namespace density {
         {   DENSITY_MEMCPY(&signature, in->pointer, sizeof(signature));
             in->pointer += sizeof(signature); }
         DENSITY_INLINE void
-        update_predictions_model(lion_dictionary_t::prediction_t *const predictions,
+        update_predictions_model(typename dictionary_t::prediction_t *const predictions,
                                  const uint32_t chunk)
         {   DENSITY_MEMMOVE((uint32_t *) predictions + 1, predictions, 2 * sizeof(uint32_t));
             // Move chunk to the top of the predictions list
-            *(uint32_t *) predictions = chunk; }
+            *(uint32_t *) predictions = chunk;
+            dictionary.touch(last_hash); }
         DENSITY_INLINE void
-        update_dictionary_model(lion_dictionary_t::entry_t *const entry,
+        update_dictionary_model(typename dictionary_t::entry_t *const entry,
                                 const uint32_t chunk)
         {   DENSITY_MEMMOVE((uint32_t *) entry + 1, entry, 3 * sizeof(uint32_t));
             *(uint32_t *) entry = chunk; }
         DENSITY_INLINE void
         read_hash(location_t *in, uint16_t *const hash)
         {   DENSITY_MEMCPY(hash, in->pointer, sizeof(uint16_t));
+            *hash = hash_mask<HASH_BITS>(*hash);
             in->pointer += sizeof(uint16_t); }
         DENSITY_INLINE void
         prediction_generic(location_t *out, uint16_t *const hash,
                            uint32_t *const chunk)
-        {   *hash = hash_algorithm(*chunk);
+        {   *hash = hash_algorithm<HASH_BITS>(*chunk);
             DENSITY_MEMCPY(out->pointer, chunk, sizeof(*chunk));
             out->pointer += sizeof(*chunk); }
         DENSITY_INLINE void
@@ -234,7 +269,7 @@ namespace density {
                            uint16_t *const hash, uint32_t *const chunk)
         {   DENSITY_MEMCPY(out->pointer, chunk, sizeof(*chunk));
             out->pointer += sizeof(*chunk);
-            lion_dictionary_t::prediction_t *p = &(dictionary.predictions[last_hash]);
+            typename dictionary_t::prediction_t *p = &(dictionary.predictions[last_hash]);
             update_predictions_model(p, *chunk); }
         void prediction_a(location_t *in, location_t *out,
                           uint16_t *const hash, uint32_t *const chunk);
@@ -254,6 +289,11 @@ namespace density {
         void chunk(location_t *in, location_t *out, const lion_form_t form);
         const lion_form_t read_form(location_t *in);
         void process_form(location_t *in, location_t *out);
+        uint_fast8_t process_run(location_t *in, location_t *out);
+        void process_unit_generic(location_t *in, location_t *out);
+#if DENSITY_X86_SIMD == DENSITY_YES
+        DENSITY_TARGET("bmi,bmi2") void process_unit_bmi2(location_t *in, location_t *out);
+#endif
         void process_unit_(location_t *in, location_t *out);
         step_by_step_status_t
         chunk_step_by_step(location_t *read_memory_location, teleport_t *in, location_t *out);
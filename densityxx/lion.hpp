@@ -95,16 +95,16 @@ namespace density {
     }
 
     //--- encode ---
-    DENSITY_INLINE void
-    lion_encode_t::prepare_new_signature(location_t *out)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    lion_encode_t<HASH_BITS, STATS_T>::prepare_new_signature(location_t *out)
     {
         signature = (lion_signature_t *) (out->pointer);
         proximity_signature = 0;
         out->pointer += sizeof(lion_signature_t);
     }
 
-    DENSITY_INLINE kernel_encode_t::state_t
-    lion_encode_t::check_block_state(void)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    lion_encode_t<HASH_BITS, STATS_T>::check_block_state(void)
     {
         if (DENSITY_LIKELY((chunks_count & (lion_chunks_per_process_unit_big - 1))))
             return state_ready;
@@ -128,8 +128,9 @@ namespace density {
         return state_ready;
     }
 
-    DENSITY_INLINE void
-    lion_encode_t::push_to_proximity_signature(const uint64_t content, const uint_fast8_t bits)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    lion_encode_t<HASH_BITS, STATS_T>::push_to_proximity_signature(const uint64_t content,
+                                                          const uint_fast8_t bits)
     {
 #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
         proximity_signature |= (content << shift);
@@ -141,9 +142,10 @@ namespace density {
         shift += bits;
     }
 
-    DENSITY_INLINE void
-    lion_encode_t::push_to_signature(location_t *out, const uint64_t content,
-                                     const uint_fast8_t bits)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    lion_encode_t<HASH_BITS, STATS_T>::push_to_signature(location_t *out,
+                                                         const uint64_t content,
+                                                         const uint_fast8_t bits)
     {
         if (DENSITY_LIKELY(shift)) {
             push_to_proximity_signature(content, bits);
@@ -162,8 +164,9 @@ namespace density {
         }
     }
 #if 0
-    void
-    lion_encode_t::push_zero_to_signature(location_t *out, const uint_fast8_t bits)
+    template<uint_fast8_t HASH_BITS, class STATS_T> void
+    lion_encode_t<HASH_BITS, STATS_T>::push_zero_to_signature(location_t *out,
+                                                              const uint_fast8_t bits)
     {
         if (DENSITY_LIKELY(shift)) {
             shift += bits;
@@ -183,20 +186,22 @@ namespace density {
     }
 #endif
 #define DENSITY_LION_KERNEL_PUSH_SAVE(LION_FORM, VAR)                   \
+        stats.lion(LION_FORM);                                          \
         push_code_to_signature(out, form_data.get_encoding(LION_FORM)); \
         DENSITY_MEMCPY(out->pointer, &VAR, sizeof(VAR));                \
         out->pointer += sizeof(VAR)
-    DENSITY_INLINE void
-    lion_encode_t::kernel(location_t *out, const uint16_t hash, const uint32_t chunk)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    lion_encode_t<HASH_BITS, STATS_T>::kernel(location_t *out, const uint16_t hash,
+                                     const uint32_t chunk)
     {
-        lion_dictionary_t *const dictionary = &this->dictionary;
-        lion_dictionary_t::prediction_t *const predictions =
+        dictionary_t *const dictionary = &this->dictionary;
+        typename dictionary_t::prediction_t *const predictions =
             &dictionary->predictions[last_hash];
         __builtin_prefetch(&dictionary->predictions[hash]);
         if (*(uint32_t *) predictions != chunk) {
             if (*((uint32_t *) predictions + 1) != chunk) {
                 if (*((uint32_t *) predictions + 2) != chunk) {
-                    lion_dictionary_t::entry_t *const in_dictionary =
+                    typename dictionary_t::entry_t *const in_dictionary =
                         &dictionary->entries[hash];
                     if (*(uint32_t *) in_dictionary != chunk) {
                         if (*((uint32_t *) in_dictionary + 1) != chunk) {
@@ -215,38 +220,66 @@ namespace density {
                         DENSITY_MEMMOVE((uint32_t*)in_dictionary + 1, in_dictionary,
                                         3 * sizeof(uint32_t));
                         *(uint32_t *)in_dictionary = chunk;
+                        dictionary->touch(hash);
                     } else {
                         DENSITY_LION_KERNEL_PUSH_SAVE(lion_form_dictionary_a, hash);
                     }
                 } else {
+                    stats.lion(lion_form_predictions_c);
                     push_code_to_signature(out, form_data.get_encoding(lion_form_predictions_c));
                 }
             } else {
+                stats.lion(lion_form_predictions_b);
                 push_code_to_signature(out, form_data.get_encoding(lion_form_predictions_b));
             }
             DENSITY_MEMMOVE((uint32_t*)predictions + 1, predictions, 2 * sizeof(uint32_t));
             *(uint32_t *)predictions = chunk;
-        } else
+            dictionary->touch(last_hash);
+        } else {
+            stats.lion(lion_form_predictions_a);
             push_code_to_signature(out, form_data.get_encoding(lion_form_predictions_a));
+        }
         last_hash = hash;
     }
 
-    DENSITY_INLINE void
-    lion_encode_t::process_unit_generic(const uint_fast8_t chunks_per_process_unit,
-                                        const uint_fast16_t process_unit_size,
-                                        location_t *in, location_t *out)
+    // A run is soon predicted by itself and that prediction takes the shortest code, only
+    // the usage of the form and its 1 bit code are then left to update for every chunk.
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    lion_encode_t<HASH_BITS, STATS_T>::process_run(const uint_fast8_t chunks_per_process_unit,
+                                          const uint_fast16_t process_unit_size,
+                                          location_t *in, location_t *out)
+    {
+        uint8_t *const usages = (uint8_t *)&form_data.usages;
+        uint32_t chunk;
+        DENSITY_MEMCPY(&chunk, in->pointer, sizeof(chunk));
+        const uint16_t hash = hash_algorithm<HASH_BITS>(chunk);
+        for (uint_fast8_t count = 0; count < chunks_per_process_unit; ++count)
+            if (last_hash == hash && dictionary.predictions[hash].next_chunk_a == chunk &&
+                form_data.forms_pool[0].form == lion_form_predictions_a) {
+                form_data.flatten(++usages[lion_form_predictions_a]);
+                stats.lion(lion_form_predictions_a);
+                push_code_to_signature(out, lion_form_entropy_codes[0]);
+            } else kernel(out, hash, chunk);
+        in->pointer += process_unit_size;
+        chunks_count += chunks_per_process_unit;
+        in->available_bytes -= process_unit_size;
+    }
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    lion_encode_t<HASH_BITS, STATS_T>::process_unit_generic
+    (const uint_fast8_t chunks_per_process_unit, const uint_fast16_t process_unit_size,
+     location_t *in, location_t *out)
     {
         uint32_t chunk;
 #ifdef __clang__
         for (uint_fast8_t count = 0; count < (chunks_per_process_unit >> 2); count++) {
             DENSITY_UNROLL_4(DENSITY_MEMCPY(&chunk, in->pointer, sizeof(uint32_t)); \
-                             kernel(out, hash_algorithm(chunk), chunk); \
+                             kernel(out, hash_algorithm<HASH_BITS>(chunk), chunk); \
                              in->pointer += sizeof(uint32_t));
         }
 #else
         for (uint_fast8_t count = 0; count < (chunks_per_process_unit >> 1); count++) {
             DENSITY_UNROLL_2(DENSITY_MEMCPY(&chunk, in->pointer, sizeof(uint32_t)); \
-                             kernel(out, hash_algorithm(chunk), chunk); \
+                             kernel(out, hash_algorithm<HASH_BITS>(chunk), chunk); \
                              in->pointer += sizeof(uint32_t));
         }
 #endif
@@ -254,25 +287,52 @@ namespace density {
         in->available_bytes -= process_unit_size;
     }
 
-    DENSITY_INLINE void
-    lion_encode_t::process_step_unit(location_t *in, location_t *out)
+#if DENSITY_X86_SIMD == DENSITY_YES
+    // The same kernel with the variable shifts of the signature pushes in shlx/shrx.
+    template<uint_fast8_t HASH_BITS, class STATS_T> void
+    lion_encode_t<HASH_BITS, STATS_T>::process_unit_generic_bmi2
+    (const uint_fast8_t chunks_per_process_unit, const uint_fast16_t process_unit_size,
+     location_t *in, location_t *out)
+    {   process_unit_generic(chunks_per_process_unit, process_unit_size, in, out); }
+#endif
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    lion_encode_t<HASH_BITS, STATS_T>::process_unit_dispatch
+    (const uint_fast8_t chunks_per_process_unit, const uint_fast16_t process_unit_size,
+     location_t *in, location_t *out)
+    {
+        if (DENSITY_UNLIKELY(kernel_run(in->pointer, process_unit_size, sizeof(uint32_t)))) {
+            process_run(chunks_per_process_unit, process_unit_size, in, out);
+            return;
+        }
+#if DENSITY_X86_SIMD == DENSITY_YES
+        if (bmi2) {
+            process_unit_generic_bmi2(chunks_per_process_unit, process_unit_size, in, out);
+            return;
+        }
+#endif
+        process_unit_generic(chunks_per_process_unit, process_unit_size, in, out);
+    }
+
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE void
+    lion_encode_t<HASH_BITS, STATS_T>::process_step_unit(location_t *in, location_t *out)
     {
         uint32_t chunk;
         DENSITY_MEMCPY(&chunk, in->pointer, sizeof(chunk));
-        kernel(out, hash_algorithm(LITTLE_ENDIAN_32(chunk)), chunk);
+        kernel(out, hash_algorithm<HASH_BITS>(LITTLE_ENDIAN_32(chunk)), chunk);
         chunks_count++;
         in->pointer += sizeof(chunk);
         in->available_bytes -= sizeof(chunk);
     }
 
-    DENSITY_INLINE kernel_encode_t::state_t
-    lion_encode_t::init(void)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    lion_encode_t<HASH_BITS, STATS_T>::init(void)
     {
         chunks_count = 0;
         efficiency_checked = false;
         signature = NULL;
         shift = 0;
         dictionary.reset();
+        bmi2 = cpu_bmi2();
 #if DENSITY_ENABLE_PARALLELIZABLE_DECOMPRESSIBLE_OUTPUT == DENSITY_YES
         reset_cycle = dictionary_preferred_reset_cycle - 1;
 #endif
@@ -301,8 +361,8 @@ namespace density {
     }
 #endif
 
-    DENSITY_INLINE kernel_encode_t::state_t
-    lion_encode_t::continue_(teleport_t *in, location_t *out)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    lion_encode_t<HASH_BITS, STATS_T>::continue_(teleport_t *in, location_t *out)
     {
         state_t return_state;
         uint8_t *pointer_out_before;
@@ -364,8 +424,8 @@ namespace density {
         // New loop
         goto check_block_state;
     }
-    DENSITY_INLINE kernel_encode_t::state_t
-    lion_encode_t::finish(teleport_t *in, location_t *out)
+    template<uint_fast8_t HASH_BITS, class STATS_T> DENSITY_INLINE kernel_encode_t::state_t
+    lion_encode_t<HASH_BITS, STATS_T>::finish(teleport_t *in, location_t *out)
     {
         state_t return_state;
         uint8_t *pointer_out_before;
@@ -472,8 +532,8 @@ static const uint8_t lion_decode_bitmasks[DENSITY_LION_DECODE_NUMBER_OF_BITMASK_
     DENSITY_BINARY_TO_UINT(1111111)
 };
 #endif
-    DENSITY_INLINE kernel_decode_t::state_t
-    lion_decode_t::check_block_state(void)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    lion_decode_t<HASH_BITS>::check_block_state(void)
     {
         if (DENSITY_UNLIKELY((chunks_count >= lion_preferred_efficiency_check_chunks)
                              && (!efficiency_checked))) {
@@ -493,8 +553,8 @@ static const uint8_t lion_decode_bitmasks[DENSITY_LION_DECODE_NUMBER_OF_BITMASK_
         }
         return state_ready;
     }
-    DENSITY_INLINE void
-    lion_decode_t::prediction_a(location_t *in, location_t *out,
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    lion_decode_t<HASH_BITS>::prediction_a(location_t *in, location_t *out,
                                 uint16_t *const hash, uint32_t *const chunk)
     {
         *chunk = dictionary.predictions[last_hash].next_chunk_a;
@@ -502,30 +562,30 @@ static const uint8_t lion_decode_bitmasks[DENSITY_LION_DECODE_NUMBER_OF_BITMASK_
         last_chunk = *chunk;
         last_hash = *hash;
     }
-    DENSITY_INLINE void
-    lion_decode_t::prediction_b(location_t *in, location_t *out,
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    lion_decode_t<HASH_BITS>::prediction_b(location_t *in, location_t *out,
                                 uint16_t *const hash, uint32_t *const chunk)
     {
-        lion_dictionary_t::prediction_t *const p = &dictionary.predictions[last_hash];
+        typename dictionary_t::prediction_t *const p = &dictionary.predictions[last_hash];
         *chunk = p->next_chunk_b;
         update_predictions_model(p, *chunk);
         prediction_generic(out, hash, chunk);
         last_chunk = *chunk;
         last_hash = *hash;
     }
-    DENSITY_INLINE void
-    lion_decode_t::prediction_c(location_t *in, location_t *out,
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    lion_decode_t<HASH_BITS>::prediction_c(location_t *in, location_t *out,
                                 uint16_t *const hash, uint32_t *const chunk)
     {
-        lion_dictionary_t::prediction_t *const p = &dictionary.predictions[last_hash];
+        typename dictionary_t::prediction_t *const p = &dictionary.predictions[last_hash];
         *chunk = p->next_chunk_c;
         update_predictions_model(p, *chunk);
         prediction_generic(out, hash, chunk);
         last_chunk = *chunk;
         last_hash = *hash;
     }
-    DENSITY_INLINE void
-    lion_decode_t::dictionary_a(location_t *in, location_t *out,
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    lion_decode_t<HASH_BITS>::dictionary_a(location_t *in, location_t *out,
                                 uint16_t *const hash, uint32_t *const chunk)
     {
         read_hash(in, hash);
@@ -535,63 +595,67 @@ static const uint8_t lion_decode_bitmasks[DENSITY_LION_DECODE_NUMBER_OF_BITMASK_
         last_chunk = *chunk;
         last_hash = *hash;
     }
-    DENSITY_INLINE void
-    lion_decode_t::dictionary_b(location_t *in, location_t *out,
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    lion_decode_t<HASH_BITS>::dictionary_b(location_t *in, location_t *out,
                                 uint16_t *const hash, uint32_t *const chunk)
     {
         read_hash(in, hash);
         __builtin_prefetch(&dictionary.predictions[*hash]);
-        lion_dictionary_t::entry_t *entry = &dictionary.entries[*hash];
+        typename dictionary_t::entry_t *entry = &dictionary.entries[*hash];
         *chunk = entry->chunk_b;
         update_dictionary_model(entry, *chunk);
+        dictionary.touch(*hash);
         dictionary_generic(in, out, hash, chunk);
         last_chunk = *chunk;
         last_hash = *hash;
     }
-    DENSITY_INLINE void
-    lion_decode_t::dictionary_c(location_t *in, location_t *out,
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    lion_decode_t<HASH_BITS>::dictionary_c(location_t *in, location_t *out,
                                 uint16_t *const hash, uint32_t *const chunk)
     {
         read_hash(in, hash);
         __builtin_prefetch(&dictionary.predictions[*hash]);
-        lion_dictionary_t::entry_t *entry = &dictionary.entries[*hash];
+        typename dictionary_t::entry_t *entry = &dictionary.entries[*hash];
         *chunk = entry->chunk_c;
         update_dictionary_model(entry, *chunk);
+        dictionary.touch(*hash);
         dictionary_generic(in, out, hash, chunk);
         last_chunk = *chunk;
         last_hash = *hash;
     }
-    DENSITY_INLINE void
-    lion_decode_t::dictionary_d(location_t *in, location_t *out,
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    lion_decode_t<HASH_BITS>::dictionary_d(location_t *in, location_t *out,
                                 uint16_t *const hash, uint32_t *const chunk)
     {
         read_hash(in, hash);
         __builtin_prefetch(&dictionary.predictions[*hash]);
-        lion_dictionary_t::entry_t *entry = &dictionary.entries[*hash];
+        typename dictionary_t::entry_t *entry = &dictionary.entries[*hash];
         *chunk = entry->chunk_d;
         update_dictionary_model(entry, *chunk);
+        dictionary.touch(*hash);
         dictionary_generic(in, out, hash, chunk);
         last_chunk = *chunk;
         last_hash = *hash;
     }
-    DENSITY_INLINE void
-    lion_decode_t::plain(location_t *in, location_t *out,
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    lion_decode_t<HASH_BITS>::plain(location_t *in, location_t *out,
                          uint16_t *const hash, uint32_t *const chunk)
     {
         DENSITY_MEMCPY(chunk, in->pointer, sizeof(*chunk));
         in->pointer += sizeof(*chunk);
-        *hash = hash_algorithm(*chunk);
-        lion_dictionary_t::entry_t *entry = &dictionary.entries[*hash];
+        *hash = hash_algorithm<HASH_BITS>(*chunk);
+        typename dictionary_t::entry_t *entry = &dictionary.entries[*hash];
         update_dictionary_model(entry, *chunk);
+        dictionary.touch(*hash);
         DENSITY_MEMCPY(out->pointer, chunk, sizeof(*chunk));
         out->pointer += sizeof(*chunk);
-        lion_dictionary_t::prediction_t *p = &(dictionary.predictions[last_hash]);
+        typename dictionary_t::prediction_t *p = &(dictionary.predictions[last_hash]);
         update_predictions_model(p, *chunk);
         last_chunk = *chunk;
         last_hash = *hash;
     }
-    DENSITY_INLINE void
-    lion_decode_t::chunk(location_t *in, location_t *out,
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    lion_decode_t<HASH_BITS>::chunk(location_t *in, location_t *out,
                          const lion_form_t form)
     {
         uint16_t hash; uint32_t chunk;
@@ -607,8 +671,8 @@ static const uint8_t lion_decode_bitmasks[DENSITY_LION_DECODE_NUMBER_OF_BITMASK_
         default: break;
         }
     }
-    DENSITY_INLINE const lion_form_t
-    lion_decode_t::read_form(location_t *in)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE const lion_form_t
+    lion_decode_t<HASH_BITS>::read_form(location_t *in)
     {
         const uint_fast8_t shift = this->shift;
         lion_form_node_t *forms_pool = form_data.forms_pool;
@@ -637,8 +701,8 @@ static const uint8_t lion_decode_bitmasks[DENSITY_LION_DECODE_NUMBER_OF_BITMASK_
                                              secondary_trailing_zeroes);
         }
     }
-    DENSITY_INLINE void
-    lion_decode_t::process_form(location_t *in, location_t *out)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    lion_decode_t<HASH_BITS>::process_form(location_t *in, location_t *out)
     {
         const uint_fast8_t shift = this->shift;
         if (DENSITY_UNLIKELY(!shift))  read_signature_from_memory(in);
@@ -650,9 +714,46 @@ static const uint8_t lion_decode_bitmasks[DENSITY_LION_DECODE_NUMBER_OF_BITMASK_
             break;
         }
     }
-    DENSITY_INLINE void
-    lion_decode_t::process_unit_(location_t *in, location_t *out)
+    // While the last chunk predicts itself with the shortest code, every 1 bit of the
+    // signature is a copy of it. Returns the number of chunks decoded.
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE uint_fast8_t
+    lion_decode_t<HASH_BITS>::process_run(location_t *in, location_t *out)
+    {
+        uint8_t *const usages = (uint8_t *)&form_data.usages;
+        uint_fast8_t count = 0;
+        while (count < lion_chunks_per_process_unit_big &&
+               form_data.forms_pool[0].form == lion_form_predictions_a &&
+               dictionary.predictions[last_hash].next_chunk_a == last_chunk) {
+            if (!shift) read_signature_from_memory(in);
+            const lion_signature_t zeroes = ~(signature >> shift);
+            uint_fast8_t ones = zeroes ? __builtin_ctzll(zeroes):
+                DENSITY_BITSIZEOF(lion_signature_t);
+            if (ones > lion_chunks_per_process_unit_big - count)
+                ones = lion_chunks_per_process_unit_big - count;
+            if (!ones) {
+                // The signature is read already, process_form() would read it again.
+                chunk(in, out, read_form(in));
+                ++count;
+                continue;
+            }
+            kernel_fill(out->pointer, last_chunk, ones);
+            out->pointer += ones * sizeof(last_chunk);
+            for (uint_fast8_t idx = 0; idx < ones; ++idx)
+                form_data.flatten(++usages[lion_form_predictions_a]);
+            shift = (shift + ones) & 0x3f;
+            count += ones;
+        }
+        return count;
+    }
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    lion_decode_t<HASH_BITS>::process_unit_generic(location_t *in, location_t *out)
     {
+        uint_fast8_t count = process_run(in, out);
+        if (DENSITY_UNLIKELY(count)) {
+            for (; count < lion_chunks_per_process_unit_big; ++count) process_form(in, out);
+            chunks_count += lion_chunks_per_process_unit_big;
+            return;
+        }
 #ifdef __clang__
         for (uint_fast8_t count = 0; count < (lion_chunks_per_process_unit_big >> 2); count++) {
             DENSITY_UNROLL_4(process_form(in, out));
@@ -664,8 +765,26 @@ static const uint8_t lion_decode_bitmasks[DENSITY_LION_DECODE_NUMBER_OF_BITMASK_
 #endif
         chunks_count += lion_chunks_per_process_unit_big;
     }
-    DENSITY_INLINE lion_decode_t::step_by_step_status_t
-    lion_decode_t::chunk_step_by_step(location_t *read_memory_location,
+#if DENSITY_X86_SIMD == DENSITY_YES
+    // The same loop with the signature shifts and form codes counts in shrx/tzcnt.
+    template<uint_fast8_t HASH_BITS> void
+    lion_decode_t<HASH_BITS>::process_unit_bmi2(location_t *in, location_t *out)
+    {   process_unit_generic(in, out); }
+#endif
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE void
+    lion_decode_t<HASH_BITS>::process_unit_(location_t *in, location_t *out)
+    {
+#if DENSITY_X86_SIMD == DENSITY_YES
+        if (bmi2) {
+            process_unit_bmi2(in, out);
+            return;
+        }
+#endif
+        process_unit_generic(in, out);
+    }
+    template<uint_fast8_t HASH_BITS>
+    DENSITY_INLINE typename lion_decode_t<HASH_BITS>::step_by_step_status_t
+    lion_decode_t<HASH_BITS>::chunk_step_by_step(location_t *read_memory_location,
                                       teleport_t *in, location_t *out)
     {
         uint8_t *start_pointer = read_memory_location->pointer;
@@ -690,14 +809,15 @@ static const uint8_t lion_decode_bitmasks[DENSITY_LION_DECODE_NUMBER_OF_BITMASK_
         return step_by_step_status_proceed;
     }
 
-    DENSITY_INLINE kernel_decode_t::state_t
-    lion_decode_t::init(const main_header_parameters_t parameters,
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    lion_decode_t<HASH_BITS>::init(const main_header_parameters_t parameters,
                         const uint_fast8_t end_data_overhead)
     {
         chunks_count = 0;
         efficiency_checked = false;
         shift = 0;
         dictionary.reset();
+        bmi2 = cpu_bmi2();
         this->parameters = parameters;
         uint8_t reset_dictionary_cycle_shift = parameters.as_bytes[0];
         if (reset_dictionary_cycle_shift)
@@ -715,8 +835,8 @@ static const uint8_t lion_decode_bitmasks[DENSITY_LION_DECODE_NUMBER_OF_BITMASK_
 // 8 bytes (new signature) + 3 bits (lowest rank form) + 2 * (3 bit flags (DENSITY_LION_FORM_SECONDARY_ACCESS + DENSITY_LION_BIGRAM_PRIMARY_SIGNATURE_FLAG_SECONDARY_ACCESS + DENSITY_LION_BIGRAM_SECONDARY_SIGNATURE_FLAG_PLAIN) + 2 bytes)
 #define DENSITY_LION_DECODE_MAX_BYTES_TO_READ_FOR_PROCESS_UNIT \
     (1 + ((lion_chunks_per_process_unit_big * DENSITY_LION_DECODE_MAX_BITS_TO_READ_FOR_CHUNK) >> 3))
-    DENSITY_INLINE kernel_decode_t::state_t
-    lion_decode_t::continue_(teleport_t *in, location_t *out)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    lion_decode_t<HASH_BITS>::continue_(teleport_t *in, location_t *out)
     {
         state_t return_state;
         location_t *read_memory_location;
@@ -753,8 +873,8 @@ static const uint8_t lion_decode_bitmasks[DENSITY_LION_DECODE_NUMBER_OF_BITMASK_
         // New loop
         goto check_block_state;
     }
-    DENSITY_INLINE kernel_decode_t::state_t
-    lion_decode_t::finish(teleport_t *in, location_t *out)
+    template<uint_fast8_t HASH_BITS> DENSITY_INLINE kernel_decode_t::state_t
+    lion_decode_t<HASH_BITS>::finish(teleport_t *in, location_t *out)
     {
         state_t return_state;
         location_t *read_memory_location;
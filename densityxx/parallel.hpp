@@ -0,0 +1,94 @@
+// see LICENSE.md for license.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "densityxx/globals.hpp"
+
+namespace density {
+    DENSITY_INLINE unsigned parallel_threads(const unsigned threads)
+    {   if (threads) return threads;
+        const unsigned hardware = std::thread::hardware_concurrency();
+        return hardware ? hardware: 1; }
+
+    // Every worker pulls the next job index until all of them are taken, so the jobs
+    // are started in increasing order.
+    template<class WORKER_T>static void
+    parallel_loop(WORKER_T *worker, std::atomic<uint_fast64_t> *next, const uint_fast64_t count)
+    {
+        uint_fast64_t index;
+        while ((index = (*next)++) < count) (*worker)(index);
+    }
+    // The calling thread is used as the first worker.
+    template<class WORKER_T>static DENSITY_INLINE void
+    parallel_run(WORKER_T *workers, const unsigned threads, const uint_fast64_t count)
+    {
+        std::atomic<uint_fast64_t> next(0);
+        std::vector<std::thread> pool;
+        for (unsigned idx = 1; idx < threads; ++idx)
+            pool.push_back(std::thread(parallel_loop<WORKER_T>, workers + idx, &next, count));
+        parallel_loop(workers, &next, count);
+        for (unsigned idx = 0; idx < pool.size(); ++idx) pool[idx].join();
+    }
+
+    // Lets the workers append their results to the output in job order.
+    class parallel_sequencer_t {
+    private:
+        std::mutex mutex;
+        std::condition_variable turn;
+        uint_fast64_t current;
+    public:
+        DENSITY_INLINE parallel_sequencer_t(void): current(0) {}
+        DENSITY_INLINE void wait(const uint_fast64_t index)
+        {   std::unique_lock<std::mutex> lock(mutex);
+            while (current != index) turn.wait(lock); }
+        DENSITY_INLINE void done(void)
+        {   std::lock_guard<std::mutex> lock(mutex);
+            ++current;
+            turn.notify_all(); }
+    };
+
+    // A thread running the jobs posted to it in order, wait returns once all of them are
+    // done.
+    class parallel_helper_t {
+    private:
+        std::mutex mutex;
+        std::condition_variable posted, drained;
+        std::deque<std::function<void(void)> > jobs;
+        bool stopping;
+        std::thread thread;
+        void loop(void)
+        {   std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                while (jobs.empty() && !stopping) posted.wait(lock);
+                if (jobs.empty()) return;
+                // The job stays queued while it runs, so wait sees it.
+                const std::function<void(void)> job = jobs.front();
+                lock.unlock();
+                job();
+                lock.lock();
+                jobs.pop_front();
+                if (jobs.empty()) drained.notify_all();
+            } }
+    public:
+        DENSITY_INLINE parallel_helper_t(void):
+            stopping(false), thread(&parallel_helper_t::loop, this) {}
+        DENSITY_INLINE ~parallel_helper_t()
+        {   {   std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+                posted.notify_one(); }
+            thread.join(); }
+        DENSITY_INLINE void post(const std::function<void(void)> &job)
+        {   std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+            posted.notify_one(); }
+        DENSITY_INLINE void wait(void)
+        {   std::unique_lock<std::mutex> lock(mutex);
+            while (!jobs.empty()) drained.wait(lock); }
+    };
+}
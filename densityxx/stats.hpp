@@ -0,0 +1,72 @@
+// see LICENSE.md for license.
+#pragma once
+
+#include <vector>
+#include "densityxx/globals.hpp"
+
+namespace density {
+    // What an encoder did with its input, block by block and within the kernels, to see
+    // why a stream compresses the way it does. Counts add up from call to call until
+    // cleared.
+    struct stats_block_t {
+        compression_mode_t mode;        // Kernel of the block, or copy
+        bool fallback;                  // Switched to copy by an efficiency check
+        uint_fast64_t bytes_read, bytes_written;
+    };
+    struct stats_t {
+        std::vector<stats_block_t> blocks;
+        // Blocks of compression_mode_adaptive given to chameleon, cheetah and lion.
+        uint_fast64_t adaptive_blocks[3];
+        // Chunks found in the chameleon dictionary, out of all those encoded.
+        uint_fast64_t chameleon_hits, chameleon_chunks;
+        // Chunks encoded by cheetah, by cheetah_signature_flag_t.
+        uint_fast64_t cheetah_flags[4];
+        // Chunks encoded by lion, by lion_form_t.
+        uint_fast64_t lion_forms[8];
+
+        inline stats_t(void) { clear(); }
+        inline void clear(void)
+        {   blocks.clear();
+            memset(adaptive_blocks, 0, sizeof(adaptive_blocks));
+            chameleon_hits = chameleon_chunks = 0;
+            memset(cheetah_flags, 0, sizeof(cheetah_flags));
+            memset(lion_forms, 0, sizeof(lion_forms)); }
+    };
+
+    // Policies of the encoders, stats_off_t compiles the counting out, stats_on_t adds to
+    // the stats_t attached, if any.
+    class stats_off_t {
+    public:
+        DENSITY_INLINE void attach(stats_t *counters) {}
+        DENSITY_INLINE void block(const compression_mode_t mode, const bool fallback,
+                                  const uint_fast64_t bytes_read,
+                                  const uint_fast64_t bytes_written) {}
+        DENSITY_INLINE void adaptive_block(const uint_fast8_t kernel) {}
+        DENSITY_INLINE void chameleon(const uint_fast8_t hits, const uint_fast8_t chunks) {}
+        DENSITY_INLINE void cheetah(const uint_fast8_t flag, const uint_fast8_t chunks) {}
+        DENSITY_INLINE void lion(const uint_fast8_t form) {}
+    };
+    class stats_on_t {
+    public:
+        DENSITY_INLINE stats_on_t(void): counters(NULL) {}
+        DENSITY_INLINE void attach(stats_t *counters) { this->counters = counters; }
+        DENSITY_INLINE void block(const compression_mode_t mode, const bool fallback,
+                                  const uint_fast64_t bytes_read,
+                                  const uint_fast64_t bytes_written)
+        {   if (!counters) return;
+            const stats_block_t block = { mode, fallback, bytes_read, bytes_written };
+            counters->blocks.push_back(block); }
+        DENSITY_INLINE void adaptive_block(const uint_fast8_t kernel)
+        {   if (counters) ++counters->adaptive_blocks[kernel]; }
+        DENSITY_INLINE void chameleon(const uint_fast8_t hits, const uint_fast8_t chunks)
+        {   if (!counters) return;
+            counters->chameleon_hits += hits;
+            counters->chameleon_chunks += chunks; }
+        DENSITY_INLINE void cheetah(const uint_fast8_t flag, const uint_fast8_t chunks)
+        {   if (counters) counters->cheetah_flags[flag] += chunks; }
+        DENSITY_INLINE void lion(const uint_fast8_t form)
+        {   if (counters) ++counters->lion_forms[form]; }
+    private:
+        stats_t *counters;
+    };
+}
@@ -1,5 +1,6 @@
 // see LICENSE.md for license.
 #include <stdarg.h>
+#include <algorithm>
 #include <chrono>
 #include "sharcxx/client.hpp"
 #include "densityxx/file_buffer.hpp"
@@ -9,6 +10,12 @@
 #include "densityxx/chameleon.hpp"
 #include "densityxx/cheetah.hpp"
 #include "densityxx/lion.hpp"
+#include "densityxx/adaptive.hpp"
+#include "densityxx/api.hpp"
+#ifdef SHARC_ALLOW_MEMORY_MAPPING
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
 
 namespace density {
 #ifdef SHARC_ALLOW_ANSI_ESCAPE_SEQUENCES
@@ -47,9 +54,27 @@ namespace density {
         printf("              1 = Chameleon algorithm (default)\n");
         printf("              2 = Cheetah algorithm\n");
         printf("              3 = Lion algorithm\n");
+        printf("              4 = Adaptive, the algorithm is switched block by block\n");
+        printf("  -a          Compress files using the algorithm compressing samples of\n");
+        printf("              them best\n");
+        printf("  -m[SPEED]   Keep -a and -c4 to the algorithms running at SPEED MB/s at\n");
+        printf("              least\n");
+        printf("  -s[SIZE]    Shuffle the bytes of the SIZE bytes numbers (2, 4 or 8,\n");
+        printf("              default 4) the files hold before compressing them\n");
+        printf("  -e[SIZE]    Encode the differences between successive SIZE bytes numbers\n");
+        printf("              before compressing, both -s and -e need regular files\n");
+        printf("  --stats     Count the blocks and what the algorithms find in the data\n");
+        printf("              while compressing, to display them afterwards\n");
         printf("  -d          Decompress files\n");
+        printf("  -b[LEVELS]  Benchmark files in memory at every digit of LEVELS (default\n");
+        printf("              01234), compressing and decompressing them over and over\n");
+        printf("  -r[COUNT]   Round trips per level of -b (default %u)\n",
+               sharc_default_round_trips);
         printf("  -p[PATH]    Set output path\n");
-        printf("  -x          Add integrity check hashsum (use when compressing)\n");
+        printf("  -x[HASH]    Add integrity check hashsum (use when compressing)\n");
+        printf("              HASH can have the following values :\n");
+        printf("              0 = SpookyHash (default)\n");
+        printf("              1 = CRC-32C, hardware accelerated on SSE4.2 processors\n");
         printf("  -f          Overwrite without prompting\n");
         printf("  -i          Read from stdin\n");
         printf("  -o          Write to stdout\n");
@@ -61,6 +86,14 @@ namespace density {
     typedef file_buffer_t<sharc_preferred_buffer_size,
                           sharc_preferred_buffer_size> sharc_file_buffer_t;
 
+    // The modes of the -c and -b levels.
+    static const compression_mode_t sharc_level_modes[] = {
+        compression_mode_copy, compression_mode_chameleon_algorithm,
+        compression_mode_cheetah_algorithm, compression_mode_lion_algorithm,
+        compression_mode_adaptive
+    };
+    const int sharc_levels = sizeof(sharc_level_modes) / sizeof(sharc_level_modes[0]);
+
     static void
     exit_error(const char *message_format, ...)
     {
@@ -105,12 +138,98 @@ namespace density {
         return file;
     }
 
+#ifdef SHARC_ALLOW_MEMORY_MAPPING
+    // Regular files are processed in one go by the in-memory API, straight from and to
+    // their mappings, without the copies and the stalls of the stream path.
+    class mapped_file_t {
+    public:
+        uint8_t *pointer;
+        uint64_t size;
+
+        inline mapped_file_t(void): pointer(NULL), size(0) {}
+        inline ~mapped_file_t() { unmap(); }
+        bool map_input(FILE *stream)
+        {   struct stat attributes;
+            if (fstat(fileno(stream), &attributes) || !S_ISREG(attributes.st_mode) ||
+                attributes.st_size <= 0) return false;
+            return map(fileno(stream), attributes.st_size, PROT_READ, MADV_SEQUENTIAL); }
+        // The stream must be a regular file open for update, whatever it holds is replaced.
+        bool map_output(FILE *stream, const uint64_t size)
+        {   struct stat attributes;
+            if (fflush(stream) || fstat(fileno(stream), &attributes) ||
+                !S_ISREG(attributes.st_mode) || !size ||
+                !map(fileno(stream), size, PROT_READ | PROT_WRITE, MADV_NORMAL)) return false;
+            // Allocated up front, faulting in the pages of a sparse file costs twice as much.
+            if (!posix_fallocate(fileno(stream), 0, size)) return true;
+            unmap();
+            return false; }
+        void unmap(void)
+        {   if (pointer) munmap(pointer, size);
+            pointer = NULL; size = 0; }
+    private:
+        bool map(const int descriptor, const uint64_t size, const int protection,
+                 const int advice)
+        {   void *mapping = mmap(NULL, size, protection, MAP_SHARED, descriptor, 0);
+            if (mapping == MAP_FAILED) return false;
+            pointer = (uint8_t *)mapping;
+            this->size = size;
+            madvise(mapping, size, advice);
+            return true; }
+    };
+
+    // total_written holds the sharc header size on entry.
+    static bool
+    compress_mapped(FILE *in, FILE *out, const compression_mode_t attempt_mode,
+                    const double minimum_speed, const filter_t filter,
+                    const uint_fast8_t element_size, const block_type_t block_type,
+                    stats_t *stats, uint64_t *total_read, uint64_t *total_written)
+    {
+        mapped_file_t input, output;
+        encoder_t encoder;
+        if (!input.map_input(in)) return false;
+        const uint64_t header_size = *total_written;
+        const uint64_t bound = compress_bound(input.size, attempt_mode, block_type);
+        if (!output.map_output(out, header_size + bound)) return false;
+        encoder.set_minimum_speed(minimum_speed);
+        encoder.set_filter(filter, element_size);
+        encoder.set_stats(stats);
+        const processing_result_t result = encoder.compress(input.pointer, input.size,
+                                                            output.pointer + header_size, bound,
+                                                            attempt_mode, block_type);
+        if (result.state) exit_error("%s\n", state_render(result.state).c_str());
+        output.unmap();
+        *total_read = result.bytes_read;
+        *total_written = header_size + result.bytes_written;
+        if (ftruncate(fileno(out), *total_written))
+            exit_error("Unable to truncate the output file.\n");
+        return true;
+    }
+    // total_read holds the sharc header size on entry.
+    static bool
+    decompress_mapped(FILE *in, FILE *out, const uint64_t original_file_size,
+                      uint64_t *total_read, uint64_t *total_written)
+    {
+        mapped_file_t input, output;
+        const uint64_t header_size = *total_read;
+        if (!input.map_input(in) || input.size <= header_size ||
+            !output.map_output(out, original_file_size)) return false;
+        const processing_result_t result = decompress(input.pointer + header_size,
+                                                      input.size - header_size,
+                                                      output.pointer, output.size);
+        if (result.state) exit_error("%s\n", state_render(result.state).c_str());
+        *total_read = header_size + result.bytes_read;
+        *total_written = result.bytes_written;
+        return true;
+    }
+#endif
+
     template<class KERNEL_ENCODE_T>static DENSITY_INLINE uint32_t
-    do_compress(context_t &context, sharc_file_buffer_t *buffer)
+    do_compress(context_t &context, sharc_file_buffer_t *buffer, stats_t *stats)
     {
         encode_state_t encode_state;
         buffer_state_t buffer_state;
         block_encode_t<KERNEL_ENCODE_T> *block_encode = new block_encode_t<KERNEL_ENCODE_T>();
+        block_encode->set_stats(stats);
         block_encode->init(context);
         while ((encode_state = context.after(block_encode->continue_(context.before()))))
             if ((buffer_state = buffer->action(encode_state, context)))
@@ -123,11 +242,94 @@ namespace density {
         delete block_encode;
         return relative_position;
     }
+    class compress_action_t {
+    public:
+        typedef bool result_t;
+        context_t &context;
+        sharc_file_buffer_t *buffer;
+        stats_t *stats;
+        uint32_t relative_position;
+
+        inline compress_action_t(context_t &context, sharc_file_buffer_t *buffer,
+                                 stats_t *stats):
+            context(context), buffer(buffer), stats(stats) {}
+        template<class KERNEL_ENCODE_T>inline bool run(void)
+        {   relative_position = do_compress<KERNEL_ENCODE_T>(context, buffer, stats);
+            return true; }
+        inline bool error(void) { return false; }
+    };
+
+    static const char *sharc_mode_names[] = {
+        "copy", "chameleon", "cheetah", "lion", "auto", "adaptive"
+    };
+    static const char *sharc_cheetah_flag_names[] = {
+        "predicted", "map_a", "map_b", "chunk"
+    };
+    static const char *sharc_lion_form_names[] = {
+        "predictions_a", "predictions_b", "predictions_c", "dictionary_a", "dictionary_b",
+        "dictionary_c", "dictionary_d", "plain"
+    };
+    static double
+    percent(const uint_fast64_t part, const uint_fast64_t whole)
+    {   return whole ? (100.0 * part) / whole: 0; }
+    // Shares of count counters, four to a line.
+    static void
+    print_shares(FILE *file, const char *title, const char **names,
+                 const uint_fast64_t *counters, const uint_fast8_t count)
+    {
+        uint_fast64_t total = 0;
+        for (uint_fast8_t idx = 0; idx < count; ++idx) total += counters[idx];
+        if (!total) return;
+        fprintf(file, "  %-10s", title);
+        for (uint_fast8_t idx = 0; idx < count; ++idx)
+            fprintf(file, "%s %s %.1lf%%", !idx ? "": idx % 4 ? ",": ",\n            ",
+                    names[idx], percent(counters[idx], total));
+        fprintf(file, " of %s chunks\n", format_decimal(total).c_str());
+    }
+    static void
+    print_stats(FILE *file, const stats_t &stats)
+    {
+        const uint_fast8_t modes = sizeof(sharc_mode_names) / sizeof(sharc_mode_names[0]);
+        // By mode, then fallbacks to copy.
+        uint_fast64_t blocks[2][modes] = {}, read[2][modes] = {}, written[2][modes] = {};
+        for (size_t idx = 0; idx < stats.blocks.size(); ++idx) {
+            const stats_block_t &block = stats.blocks[idx];
+            ++blocks[block.fallback][block.mode];
+            read[block.fallback][block.mode] += block.bytes_read;
+            written[block.fallback][block.mode] += block.bytes_written;
+        }
+        fprintf(file, "  %-10s", "Blocks");
+        const char *separator = "";
+        for (uint_fast8_t fallback = 0; fallback < 2; ++fallback)
+            for (uint_fast8_t mode = 0; mode < modes; ++mode) {
+                if (!blocks[fallback][mode]) continue;
+                fprintf(file, "%s %s %s%s %s %.1lf%%", separator,
+                        format_decimal(blocks[fallback][mode]).c_str(),
+                        sharc_mode_names[mode], fallback ? " fallback": "", sharc_arrow,
+                        percent(written[fallback][mode], read[fallback][mode]));
+                separator = ",";
+            }
+        fprintf(file, "\n");
+        if (stats.chameleon_chunks)
+            fprintf(file, "  %-10s %s of %s chunks found in the dictionary (%.1lf%%)\n",
+                    "Chameleon", format_decimal(stats.chameleon_hits).c_str(),
+                    format_decimal(stats.chameleon_chunks).c_str(),
+                    percent(stats.chameleon_hits, stats.chameleon_chunks));
+        print_shares(file, "Cheetah", sharc_cheetah_flag_names, stats.cheetah_flags, 4);
+        print_shares(file, "Lion", sharc_lion_form_names, stats.lion_forms, 8);
+        if (stats.adaptive_blocks[0] + stats.adaptive_blocks[1] + stats.adaptive_blocks[2])
+            fprintf(file, "  %-10s %s chameleon, %s cheetah, %s lion blocks\n", "Adaptive",
+                    format_decimal(stats.adaptive_blocks[0]).c_str(),
+                    format_decimal(stats.adaptive_blocks[1]).c_str(),
+                    format_decimal(stats.adaptive_blocks[2]).c_str());
+    }
     void
     client_io_t::compress(client_io_t *const io_out,
-                          const compression_mode_t attempt_mode,
-                          const bool prompting, const bool integrity_checks,
-                          const std::string &in_path, const std::string &out_path)
+                          const compression_mode_t attempt_mode, const double minimum_speed,
+                          const filter_t filter, const uint_fast8_t element_size,
+                          const bool prompting, const block_type_t block_type,
+                          const bool counting, const std::string &in_path,
+                          const std::string &out_path)
     {
         // determine in_file_path, out_file_path.
         struct stat attributes;
@@ -153,7 +355,7 @@ namespace density {
         case header_origin_type_file:
             io_out->name = name + ".sharc";
             out_file_path = out_path + io_out->name;
-            io_out->stream = check_open_file(out_file_path.c_str(), "wb", prompting);
+            io_out->stream = check_open_file(out_file_path.c_str(), "w+b", prompting);
             break;
         }
 
@@ -162,41 +364,58 @@ namespace density {
          * The following code is an example of
          * how to use the Density stream API to compress a file.
          */
-        uint32_t relative_position;
         uint64_t total_written = header_t::write(io_out->stream, origin_type, &attributes);
-        context_t context;
-        encode_state_t encode_state;
-        buffer_state_t buffer_state;
-        sharc_file_buffer_t *buffer = new sharc_file_buffer_t(this->stream, io_out->stream);
-        block_type_t block_type =
-            integrity_checks ? block_type_with_hashsum_integrity_check: block_type_default;
-
-        buffer->init(attempt_mode, block_type, context);
-        if ((buffer_state = buffer->action(encode_state_stall_on_input, context)))
-            exit_error(buffer_state);
-        while ((encode_state = context.write_header()))
-            if ((buffer_state = buffer->action(encode_state, context)))
+        uint64_t total_read = 0;
+        bool mapped = false;
+        stats_t stats;
+#ifdef SHARC_ALLOW_MEMORY_MAPPING
+        if (origin_type == header_origin_type_file &&
+            io_out->origin_type == header_origin_type_file)
+            mapped = compress_mapped(this->stream, io_out->stream, attempt_mode, minimum_speed,
+                                     filter, element_size, block_type,
+                                     counting ? &stats: NULL, &total_read, &total_written);
+#endif
+        if (!mapped) {
+            // The filters work on the whole input in memory.
+            if (filter != filter_none)
+                exit_error("Filters need regular input and output files.\n");
+            context_t context;
+            context.integrity_helper = parallel_threads(0) > 1;
+            context.minimum_speed = minimum_speed;
+            encode_state_t encode_state;
+            buffer_state_t buffer_state;
+            sharc_file_buffer_t *buffer =
+                new sharc_file_buffer_t(this->stream, io_out->stream);
+            buffer->init(attempt_mode, block_type, context);
+            if ((buffer_state = buffer->action(encode_state_stall_on_input, context)))
                 exit_error(buffer_state);
-        switch (attempt_mode) {
-        case compression_mode_copy:
-            relative_position = do_compress<copy_encode_t>(context, buffer);
-            break;
-        case compression_mode_chameleon_algorithm:
-            relative_position = do_compress<chameleon_encode_t>(context, buffer);
-            break;
-        case compression_mode_cheetah_algorithm:
-            relative_position = do_compress<cheetah_encode_t>(context, buffer);
-            break;
-        case compression_mode_lion_algorithm:
-            relative_position = do_compress<lion_encode_t>(context, buffer);
-            break;
-        }
-        while ((encode_state = context.write_footer(relative_position)))
-            if ((buffer_state = buffer->action(encode_state, context)))
+            // A stream is sampled through its first buffer.
+            compression_mode_t mode = attempt_mode;
+            if (mode == compression_mode_auto) {
+                mode = select_compression_mode(context.in.direct.pointer,
+                                               context.in.direct.available_bytes,
+                                               context.minimum_speed);
+                context.header.setup(mode, block_type);
+            }
+            while ((encode_state = context.write_header()))
+                if ((buffer_state = buffer->action(encode_state, context)))
+                    exit_error(buffer_state);
+            compress_action_t action(context, buffer, counting ? &stats: NULL);
+            if (!(counting ?
+                  dispatch_encode<compress_action_t, stats_on_t>(action, mode,
+                                                                 hash_default_bits):
+                  dispatch_encode(action, mode, hash_default_bits)))
+                exit_error("Unknown compression mode.\n");
+            while ((encode_state = context.write_footer(action.relative_position)))
+                if ((buffer_state = buffer->action(encode_state, context)))
+                    exit_error(buffer_state);
+            if ((buffer_state = buffer->action(encode_state_stall_on_output, context)) ||
+                (buffer_state = buffer->flush()))
                 exit_error(buffer_state);
-        if ((buffer_state = buffer->action(encode_state_stall_on_output, context)))
-            exit_error(buffer_state);
-        delete buffer;
+            delete buffer;
+            total_read = context.get_total_read();
+            total_written += context.get_total_written();
+        }
         /*
          * That's it !
          */
@@ -204,10 +423,8 @@ namespace density {
         if (io_out->origin_type == header_origin_type_file) {
             std::chrono::duration<double> duration = tpend - tpstart;
             const double elapsed = duration.count();
-            total_written += context.get_total_written();
             fclose(io_out->stream);
             if (origin_type == header_origin_type_file) {
-                uint64_t total_read = context.get_total_read();
                 fclose(this->stream);
                 double ratio = (100.0 * total_written) / total_read;
                 double speed = (1.0 * total_read) / (elapsed * 1000.0 * 1000.0);
@@ -225,6 +442,10 @@ namespace density {
                        format_decimal(total_written).c_str());
             }
         }
+        // Kept out of the way of a compressed standard output.
+        if (counting)
+            print_stats(io_out->origin_type == header_origin_type_file ? stdout: stderr,
+                        stats);
     }
 
     template<class KERNEL_DECODE_T>static DENSITY_INLINE void
@@ -271,7 +492,7 @@ namespace density {
                 exit_error("filename must terminated with '.sharc'.\n");
             io_out->name = name.substr(0, name.size() - 6);
             out_file_path = out_path + io_out->name;
-            io_out->stream = check_open_file(out_file_path.c_str(), "wb", prompting);
+            io_out->stream = check_open_file(out_file_path.c_str(), "w+b", prompting);
             break;
         }
 
@@ -283,37 +504,65 @@ namespace density {
         header_t header;
         uint64_t total_read = header.read(this->stream);
         if (!header.check_validity()) exit_error("Invalid file.\n");
-        context_t context;
-        decode_state_t decode_state;
-        buffer_state_t buffer_state;
-        sharc_file_buffer_t *buffer = new sharc_file_buffer_t(this->stream, io_out->stream);
+        uint64_t total_written = 0;
+        bool mapped = false;
+#ifdef SHARC_ALLOW_MEMORY_MAPPING
+        if (origin_type == header_origin_type_file &&
+            io_out->origin_type == header_origin_type_file &&
+            header.origin_type() == header_origin_type_file)
+            mapped = decompress_mapped(this->stream, io_out->stream,
+                                       header.original_file_size(),
+                                       &total_read, &total_written);
+#endif
+        if (!mapped) {
+            context_t context;
+            context.integrity_helper = parallel_threads(0) > 1;
+            decode_state_t decode_state;
+            buffer_state_t buffer_state;
+            sharc_file_buffer_t *buffer =
+                new sharc_file_buffer_t(this->stream, io_out->stream);
 
-        buffer->init(compression_mode_copy, block_type_default, context);
-        if ((buffer_state = buffer->action(decode_state_stall_on_input, context)))
-            exit_error(buffer_state);
-        while ((decode_state = context.read_header()))
-            if ((buffer_state = buffer->action(decode_state, context)))
+            buffer->init(compression_mode_copy, block_type_default, context);
+            if ((buffer_state = buffer->action(decode_state_stall_on_input, context)))
                 exit_error(buffer_state);
-        switch (context.header.compression_mode()) {
-        case compression_mode_copy:
-            do_decompress<copy_decode_t>(context, buffer);
-            break;
-        case compression_mode_chameleon_algorithm:
-            do_decompress<chameleon_decode_t>(context, buffer);
-            break;
-        case compression_mode_cheetah_algorithm:
-            do_decompress<cheetah_decode_t>(context, buffer);
-            break;
-        case compression_mode_lion_algorithm:
-            do_decompress<lion_decode_t>(context, buffer);
-            break;
-        }
-        while ((decode_state = context.read_footer()))
-            if ((buffer_state = buffer->action(decode_state, context)))
+            while ((decode_state = context.read_header()))
+                if ((buffer_state = buffer->action(decode_state, context)))
+                    exit_error(buffer_state);
+            if (context.header.segment_shift())
+                exit_error("Segmented streams can only be decompressed in memory.\n");
+            if (context.header.hash_bits() != hash_default_bits)
+                exit_error("Streams with a custom hash width can only be "
+                           "decompressed in memory.\n");
+            if (context.header.filter() != filter_none)
+                exit_error("Filtered streams can only be decompressed in memory.\n");
+            switch (context.header.compression_mode()) {
+            case compression_mode_copy:
+                do_decompress<copy_decode_t>(context, buffer);
+                break;
+            case compression_mode_chameleon_algorithm:
+                do_decompress<chameleon_decode_t<hash_default_bits> >(context, buffer);
+                break;
+            case compression_mode_cheetah_algorithm:
+                do_decompress<cheetah_decode_t<hash_default_bits> >(context, buffer);
+                break;
+            case compression_mode_lion_algorithm:
+                do_decompress<lion_decode_t<hash_default_bits> >(context, buffer);
+                break;
+            case compression_mode_adaptive:
+                do_decompress<adaptive_decode_t<hash_default_bits> >(context, buffer);
+                break;
+            default: exit_error("Unknown compression mode.\n");
+            }
+            while ((decode_state = context.read_footer()))
+                if ((buffer_state = buffer->action(decode_state, context)))
+                    exit_error(buffer_state);
+            if ((buffer_state = buffer->action(decode_state_stall_on_output, context)) ||
+                (buffer_state = buffer->flush()))
                 exit_error(buffer_state);
-        if ((buffer_state = buffer->action(decode_state_stall_on_output, context)))
-            exit_error(buffer_state);
-        delete buffer;
+            delete buffer;
+            total_read += context.get_total_read();
+            total_written = context.get_total_written();
+        }
         /*
          * That's it !
          */
@@ -321,12 +570,10 @@ namespace density {
         if (io_out->origin_type == header_origin_type_file) {
             std::chrono::duration<double> duration = tpend - tpstart;
             const double elapsed = duration.count();
-            uint64_t total_written = context.get_total_written();
             fclose(io_out->stream);
             if (header.origin_type() == header_origin_type_file)
                 header.restore_file_attributes(out_file_path.c_str());
             if (origin_type == header_origin_type_file) {
-                total_read += context.get_total_read();
                 fclose(this->stream);
                 if (header.origin_type() == header_origin_type_file &&
                     total_written != header.original_file_size())
@@ -350,6 +597,95 @@ namespace density {
             }
         }
     }
+
+    // MB/s of the fastest and of the median of durations.
+    static void
+    benchmark_speeds(const uint64_t size, std::vector<double> &durations,
+                     double *fastest, double *median)
+    {
+        std::sort(durations.begin(), durations.end());
+        const size_t middle = durations.size() / 2;
+        const double median_duration = durations.size() & 1 ? durations[middle]:
+            (durations[middle - 1] + durations[middle]) / 2;
+        *fastest = durations[0] > 0 ? size / (durations[0] * 1000.0 * 1000.0): 0;
+        *median = median_duration > 0 ? size / (median_duration * 1000.0 * 1000.0): 0;
+    }
+    void
+    client_io_t::benchmark(const uint_fast32_t levels, const unsigned round_trips,
+                           const double minimum_speed, const filter_t filter,
+                           const uint_fast8_t element_size, const block_type_t block_type,
+                           const std::string &in_path)
+    {
+        std::string in_file_path;
+        switch (origin_type) {
+        case header_origin_type_stream:
+            name = sharc_stdio;
+            in_file_path = in_path + name;
+            this->stream = stdin;
+            break;
+        case header_origin_type_file:
+            in_file_path = in_path + name;
+            this->stream = check_open_file(in_file_path.c_str(), "rb", false);
+            break;
+        }
+        // The input is loaded beforehand, only the in-memory API is timed.
+        std::vector<uint8_t> original;
+        uint8_t buffer[1 << 16];
+        size_t bytes;
+        while ((bytes = fread(buffer, 1, sizeof(buffer), this->stream)) > 0)
+            original.insert(original.end(), buffer, buffer + bytes);
+        if (ferror(this->stream)) exit_error("Unable to read %s.\n", in_file_path.c_str());
+        if (origin_type == header_origin_type_file) fclose(this->stream);
+        std::vector<uint8_t> decompressed(original.size());
+
+        printf("Benchmarked %s%s%s(%s bytes), %u round trips, fastest / median :\n",
+               sharc_esc_bold_start, in_file_path.c_str(), sharc_esc_end,
+               format_decimal(original.size()).c_str(), round_trips);
+        for (int level = 0; level < sharc_levels; ++level) {
+            if (!(levels & (1 << level))) continue;
+            const compression_mode_t mode = sharc_level_modes[level];
+            std::vector<uint8_t> compressed(compress_bound(original.size(), mode, block_type));
+            std::vector<double> compress_durations, decompress_durations;
+            uint64_t compressed_size = 0;
+            encoder_t encoder;
+            decoder_t decoder;
+            encoder.set_minimum_speed(minimum_speed);
+            encoder.set_filter(filter, element_size);
+            for (unsigned round_trip = 0; round_trip < round_trips; ++round_trip) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                processing_result_t result =
+                    encoder.compress(original.data(), original.size(), compressed.data(),
+                                     compressed.size(), mode, block_type);
+                std::chrono::duration<double> duration =
+                    std::chrono::steady_clock::now() - start;
+                if (result.state) exit_error("%s\n", state_render(result.state).c_str());
+                compress_durations.push_back(duration.count());
+                compressed_size = result.bytes_written;
+
+                start = std::chrono::steady_clock::now();
+                result = decoder.decompress(compressed.data(), compressed_size,
+                                            decompressed.data(), decompressed.size());
+                duration = std::chrono::steady_clock::now() - start;
+                if (result.state) exit_error("%s\n", state_render(result.state).c_str());
+                decompress_durations.push_back(duration.count());
+                if (result.bytes_written != original.size() ||
+                    !std::equal(original.begin(), original.end(), decompressed.begin()))
+                    exit_error("Level %d does not give %s back.\n", level,
+                               in_file_path.c_str());
+            }
+            double compress_fastest, compress_median, decompress_fastest, decompress_median;
+            benchmark_speeds(original.size(), compress_durations,
+                             &compress_fastest, &compress_median);
+            benchmark_speeds(original.size(), decompress_durations,
+                             &decompress_fastest, &decompress_median);
+            const double ratio =
+                original.size() ? (100.0 * compressed_size) / original.size(): 0;
+            printf("  -c%d %s bytes %s %.1lf%% %s compression %.0lf / %.0lf MB/s, "
+                   "decompression %.0lf / %.0lf MB/s\n", level,
+                   format_decimal(compressed_size).c_str(), sharc_arrow, ratio, sharc_arrow,
+                   compress_fastest, compress_median, decompress_fastest, decompress_median);
+        }
+    }
 }
 
 int
@@ -364,8 +700,14 @@ main(int argc, char *argv[])
 
     density::sharc_action_t action = density::sharc_action_compress;
     density::compression_mode_t mode = density::compression_mode_chameleon_algorithm;
+    double minimum_speed = 0;
+    uint_fast32_t levels = (1 << density::sharc_levels) - 1;
+    unsigned round_trips = density::sharc_default_round_trips;
+    density::filter_t filter = density::filter_none;
+    uint_fast8_t element_size = 4;
     bool prompting = true;
-    bool integrity_checks = false;
+    bool counting = false;
+    density::block_type_t block_type = density::block_type_default;
     density::client_io_t in;
     density::client_io_t out;
     bool path_mode = density::sharc_file_output_path;
@@ -378,18 +720,48 @@ main(int argc, char *argv[])
             arg_length = strlen(argv[idx]);
             if (arg_length < 2) density::usage(argv[0]);
             switch (argv[idx][1]) {
+            case '-':
+                if (strcmp(argv[idx], "--stats")) density::usage(argv[0]);
+                counting = true;
+                break;
             case 'c':
                 if (arg_length == 2) break;
+                if (arg_length != 3 || argv[idx][2] < '0' ||
+                    argv[idx][2] >= '0' + density::sharc_levels) density::usage(argv[0]);
+                mode = density::sharc_level_modes[argv[idx][2] - '0'];
+                break;
+            case 'a': mode = density::compression_mode_auto; break;
+            case 'm':
+                if (arg_length == 2) density::usage(argv[0]);
+                minimum_speed = atof(argv[idx] + 2);
+                break;
+            case 's':
+            case 'e':
+                filter = (density::filter_t)(filter | (argv[idx][1] == 's' ?
+                                                       density::filter_shuffle:
+                                                       density::filter_delta));
+                if (arg_length == 2) break;
                 if (arg_length != 3) density::usage(argv[0]);
                 switch (argv[idx][2] - '0') {
-                case 0: mode = density::compression_mode_copy; break;
-                case 1: mode = density::compression_mode_chameleon_algorithm; break;
-                case 2: mode = density::compression_mode_cheetah_algorithm; break;
-                case 3: mode = density::compression_mode_lion_algorithm; break;
+                case 2: case 4: case 8: element_size = argv[idx][2] - '0'; break;
                 default: density::usage(argv[0]);
                 }
                 break;
             case 'd': action = density::sharc_action_decompress; break;
+            case 'b':
+                action = density::sharc_action_benchmark;
+                if (arg_length == 2) break;
+                levels = 0;
+                for (size_t digit = 2; digit < arg_length; ++digit)
+                    if (argv[idx][digit] < '0' ||
+                        argv[idx][digit] >= '0' + density::sharc_levels)
+                        density::usage(argv[0]);
+                    else levels |= 1 << (argv[idx][digit] - '0');
+                break;
+            case 'r':
+                if (arg_length == 2 || !(round_trips = (unsigned)atoi(argv[idx] + 2)))
+                    density::usage(argv[0]);
+                break;
             case 'p':
                 if (arg_length == 2) density::usage(argv[0]);
                 else {
@@ -404,7 +776,18 @@ main(int argc, char *argv[])
                 }
                 break;
             case 'f': prompting = false; break;
-            case 'x': integrity_checks = true; break;
+            case 'x':
+                if (arg_length == 2) {
+                    block_type = density::block_type_with_hashsum_integrity_check;
+                    break;
+                }
+                if (arg_length != 3) density::usage(argv[0]);
+                switch (argv[idx][2] - '0') {
+                case 0: block_type = density::block_type_with_hashsum_integrity_check; break;
+                case 1: block_type = density::block_type_with_crc32c_integrity_check; break;
+                default: density::usage(argv[0]);
+                }
+                break;
             case 'i': in.origin_type = density::header_origin_type_stream; break;
             case 'o': out.origin_type = density::header_origin_type_stream; break;
             case 'v': density::version(); exit(0);
@@ -425,11 +808,16 @@ main(int argc, char *argv[])
             }
             switch (action) {
             case density::sharc_action_compress:
-                in.compress(&out, mode, prompting, integrity_checks, in_path, out_path);
+                in.compress(&out, mode, minimum_speed, filter, element_size, prompting,
+                            block_type, counting, in_path, out_path);
                 break;
             case density::sharc_action_decompress:
                 in.decompress(&out, prompting, in_path, out_path);
                 break;
+            case density::sharc_action_benchmark:
+                in.benchmark(levels, round_trips, minimum_speed, filter, element_size,
+                             block_type, in_path);
+                break;
             }
             break;
         }
@@ -437,11 +825,16 @@ main(int argc, char *argv[])
     if (in.origin_type == density::header_origin_type_stream) {
         switch (action) {
         case density::sharc_action_compress:
-            in.compress(&out, mode, prompting, integrity_checks, in_path, out_path);
+            in.compress(&out, mode, minimum_speed, filter, element_size, prompting,
+                        block_type, counting, in_path, out_path);
             break;
         case density::sharc_action_decompress:
             in.decompress(&out, prompting, in_path, out_path);
             break;
+        case density::sharc_action_benchmark:
+            in.benchmark(levels, round_trips, minimum_speed, filter, element_size,
+                         block_type, in_path);
+            break;
         }
     }
     return 0;
@@ -4,8 +4,11 @@
 #include "sharcxx/header.hpp"
 
 namespace density {
-    typedef enum { sharc_action_compress, sharc_action_decompress } sharc_action_t;
+    typedef enum {
+        sharc_action_compress, sharc_action_decompress, sharc_action_benchmark
+    } sharc_action_t;
     const size_t sharc_preferred_buffer_size = 1 << 19;
+    const unsigned sharc_default_round_trips = 5;
 
     const char *sharc_stdio = "stdio";
     const char *sharc_stdio_compressed ="stdio.sharc";
@@ -24,6 +27,7 @@ namespace density {
 #else
     const char sharc_path_separator = '/';
 #define SHARC_ALLOW_ANSI_ESCAPE_SEQUENCES
+#define SHARC_ALLOW_MEMORY_MAPPING
 #endif
 
 #if defined(_WIN64) || defined(_WIN32)
@@ -66,9 +70,16 @@ namespace density {
 
         inline client_io_t(void)
         {   name = ""; stream = NULL; origin_type = header_origin_type_file; }
-        void compress(client_io_t * const, const compression_mode_t,
-                      const bool, const bool, const std::string &, const std::string &);
+        // Displays the stats of the encoder after compressing when counting.
+        void compress(client_io_t * const, const compression_mode_t, const double,
+                      const filter_t, const uint_fast8_t, const bool,
+                      const block_type_t, const bool, const std::string &,
+                      const std::string &);
         void decompress(client_io_t * const, const bool,
                         const std::string &, const std::string &);
+        // Round trips in memory at the levels set in the bit mask, nothing is written.
+        void benchmark(const uint_fast32_t, const unsigned, const double,
+                       const filter_t, const uint_fast8_t, const block_type_t,
+                       const std::string &);
     };
 }